@@ -0,0 +1,164 @@
+/*
+ * Storage-independent access to the normalized similarity matrix W
+ * The symnmf iteration only ever needs row blocks of W * H, so each
+ * storage format contributes exactly that product.
+ */
+
+#include <stdlib.h>
+#include "affinity.h"
+#include "gemm.h"
+#include "parallel.h"
+
+#define MEAN_CHUNK 256  /* Rows of W * 1 per work item in affinity_mean */
+
+/* Wrap a dense matrix */
+affinity_t affinity_dense(const matrix_t* W) {
+    affinity_t a;
+
+    a.kind = AFFINITY_DENSE;
+    a.n = W->rows;
+    a.dense = W;
+    a.dense32 = NULL;
+    a.csr = NULL;
+    a.implicit = NULL;
+    a.packed = NULL;
+    return a;
+}
+
+/* Wrap a dense single-precision matrix */
+affinity_t affinity_dense_f32(const fmatrix_t* W) {
+    affinity_t a;
+
+    a.kind = AFFINITY_DENSE_F32;
+    a.n = W->rows;
+    a.dense = NULL;
+    a.dense32 = W;
+    a.csr = NULL;
+    a.implicit = NULL;
+    a.packed = NULL;
+    return a;
+}
+
+/* Wrap a CSR matrix */
+affinity_t affinity_csr(const csr_matrix_t* W) {
+    affinity_t a;
+
+    a.kind = AFFINITY_CSR;
+    a.n = W->rows;
+    a.dense = NULL;
+    a.dense32 = NULL;
+    a.csr = W;
+    a.implicit = NULL;
+    a.packed = NULL;
+    return a;
+}
+
+/* Wrap a matrix-free W */
+affinity_t affinity_implicit(const implicit_affinity_t* W) {
+    affinity_t a;
+
+    a.kind = AFFINITY_IMPLICIT;
+    a.n = W->n;
+    a.dense = NULL;
+    a.dense32 = NULL;
+    a.csr = NULL;
+    a.implicit = W;
+    a.packed = NULL;
+    return a;
+}
+
+/* Wrap a packed symmetric matrix */
+affinity_t affinity_packed(const packed_matrix_t* W) {
+    affinity_t a;
+
+    a.kind = AFFINITY_PACKED;
+    a.n = W->n;
+    a.dense = NULL;
+    a.dense32 = NULL;
+    a.csr = NULL;
+    a.implicit = NULL;
+    a.packed = W;
+    return a;
+}
+
+/* Rows [first, last) of W * H in the format-specific kernel */
+void affinity_multiply_rows(const affinity_t* W, const matrix_t* H,
+                            size_t first, size_t last, matrix_t* out) {
+    matrix_t dense_rows;
+    fmatrix_t dense32_rows;
+    csr_matrix_t csr_rows_view;
+
+    switch (W->kind) {
+    case AFFINITY_DENSE:
+        dense_rows = matrix_rows(W->dense, first, last);
+        matrix_multiply_into(&dense_rows, H, out);
+        break;
+    case AFFINITY_DENSE_F32:
+        dense32_rows = fmatrix_rows(W->dense32, first, last);
+        matrix_multiply_f32_into(&dense32_rows, H, out);
+        break;
+    case AFFINITY_CSR:
+        csr_rows_view = csr_rows(W->csr, first, last);
+        csr_multiply_into(&csr_rows_view, H, out);
+        break;
+    case AFFINITY_IMPLICIT:
+        implicit_multiply_rows(W->implicit, H, first, last, out);
+        break;
+    case AFFINITY_PACKED:
+        packed_multiply_rows_into(W->packed, H, first, last, out);
+        break;
+    }
+}
+
+/* Rows [first, last) of W * H with H already packed for the dense kernel */
+void affinity_multiply_rows_prepacked(const affinity_t* W, const matrix_t* H, const gemm_prepacked_t* H_packed,
+                                      double* a_scratch, size_t first, size_t last, matrix_t* out) {
+    matrix_t dense_rows;
+
+    if (W->kind == AFFINITY_DENSE) {
+        dense_rows = matrix_rows(W->dense, first, last);
+        matrix_multiply_prepacked_into(&dense_rows, H_packed, a_scratch, out);
+    } else {
+        affinity_multiply_rows(W, H, first, last, out);
+    }
+}
+
+/* Mean entry of W from the row sums W * 1, summed in row order */
+double affinity_mean(const affinity_t* W, int num_threads) {
+    matrix_t* ones;
+    matrix_t* row_sums;
+    double total;
+    size_t n, i, c, num_chunks;
+
+    n = W->n;
+    if (n == 0) return 0.0;
+    ones = matrix_create(n, 1);
+    row_sums = matrix_create(n, 1);
+    if (!ones || !row_sums) {
+        matrix_free(ones); matrix_free(row_sums);
+        return -1.0;
+    }
+    for (i = 0; i < n; i++) {
+        MATRIX_AT(ones, i, 0) = 1.0;
+    }
+    num_chunks = (n + MEAN_CHUNK - 1) / MEAN_CHUNK;
+    num_threads = resolve_num_threads(num_threads);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 1) num_threads(num_threads)
+#endif
+    for (c = 0; c < num_chunks; c++) {
+        size_t first, last;
+        matrix_t out;
+
+        first = c * MEAN_CHUNK;
+        last = first + MEAN_CHUNK < n ? first + MEAN_CHUNK : n;
+        out = matrix_rows(row_sums, first, last);
+        affinity_multiply_rows(W, ones, first, last, &out);
+    }
+    total = 0.0;
+    for (i = 0; i < n; i++) {
+        total += MATRIX_AT(row_sums, i, 0);
+    }
+    matrix_free(ones); matrix_free(row_sums);
+    return total / ((double)n * (double)n);
+}
\ No newline at end of file
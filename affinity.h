@@ -0,0 +1,112 @@
+#ifndef AFFINITY_H
+#define AFFINITY_H
+
+#include <stddef.h>
+#include "matrix.h"
+#include "sparse.h"
+#include "implicit.h"
+#include "gemm.h"
+
+/* Storage-independent access to the normalized similarity matrix W */
+
+/* Storage formats W can be held in */
+typedef enum affinity_kind_t {
+    AFFINITY_DENSE,
+    AFFINITY_DENSE_F32,
+    AFFINITY_CSR,
+    AFFINITY_IMPLICIT,
+    AFFINITY_PACKED
+} affinity_kind_t;
+
+/*
+ * Borrowed reference to W in one of the supported formats
+ * @field kind: Which of the members below is set
+ * @field n: Number of rows and columns of W
+ * @field dense: Dense W (AFFINITY_DENSE)
+ * @field dense32: Dense single-precision W (AFFINITY_DENSE_F32)
+ * @field csr: Sparse W (AFFINITY_CSR)
+ * @field implicit: Matrix-free W (AFFINITY_IMPLICIT)
+ * @field packed: Packed upper-triangular W (AFFINITY_PACKED)
+ */
+typedef struct affinity_t {
+    affinity_kind_t kind;
+    size_t n;
+    const matrix_t* dense;
+    const fmatrix_t* dense32;
+    const csr_matrix_t* csr;
+    const implicit_affinity_t* implicit;
+    const packed_matrix_t* packed;
+} affinity_t;
+
+/*
+ * Wrap a dense n x n matrix
+ * @param W: The matrix, which must outlive the returned reference
+ * @return: Affinity referring to W
+ */
+affinity_t affinity_dense(const matrix_t* W);
+
+/*
+ * Wrap a dense single-precision n x n matrix
+ * W * H still accumulates in double; only the storage of W is halved
+ * @param W: The matrix, which must outlive the returned reference
+ * @return: Affinity referring to W
+ */
+affinity_t affinity_dense_f32(const fmatrix_t* W);
+
+/*
+ * Wrap a sparse n x n matrix
+ * @param W: The matrix, which must outlive the returned reference
+ * @return: Affinity referring to W
+ */
+affinity_t affinity_csr(const csr_matrix_t* W);
+
+/*
+ * Wrap a matrix-free W
+ * @param W: The matrix-free W, which must outlive the returned reference
+ * @return: Affinity referring to W
+ */
+affinity_t affinity_implicit(const implicit_affinity_t* W);
+
+/*
+ * Wrap a packed symmetric n x n matrix
+ * @param W: The matrix, which must outlive the returned reference
+ * @return: Affinity referring to W
+ */
+affinity_t affinity_packed(const packed_matrix_t* W);
+
+/*
+ * Compute rows [first, last) of W * H
+ * @param W: Affinity (n x n)
+ * @param H: Dense matrix (n x k)
+ * @param first: First row of the product
+ * @param last: One past the last row of the product
+ * @param out: Receives the rows ((last - first) x k), overwritten
+ */
+void affinity_multiply_rows(const affinity_t* W, const matrix_t* H,
+                            size_t first, size_t last, matrix_t* out);
+
+/*
+ * Compute rows [first, last) of W * H, reusing a packing of H
+ * A dense W goes through the packed kernel with the prepacked H and the
+ * caller's scratch, so nothing is allocated or packed per call; other
+ * storages ignore the packing and behave as affinity_multiply_rows
+ * @param W: Affinity (n x n)
+ * @param H: Dense matrix (n x k)
+ * @param H_packed: H packed by gemm_prepack_rows
+ * @param a_scratch: Scratch of GEMM_A_SCRATCH doubles, one per concurrent call
+ * @param first: First row of the product
+ * @param last: One past the last row of the product
+ * @param out: Receives the rows ((last - first) x k), overwritten
+ */
+void affinity_multiply_rows_prepacked(const affinity_t* W, const matrix_t* H, const gemm_prepacked_t* H_packed,
+                                      double* a_scratch, size_t first, size_t last, matrix_t* out);
+
+/*
+ * Mean of all n^2 entries of W, computed as 1^T (W 1) / n^2
+ * @param W: Affinity (n x n)
+ * @param num_threads: Threads to use, or 0 for SYMNMF_NUM_THREADS / OpenMP default
+ * @return: The mean, or a negative value if error occurs
+ */
+double affinity_mean(const affinity_t* W, int num_threads);
+
+#endif /* AFFINITY_H */
\ No newline at end of file
@@ -0,0 +1,74 @@
+/*
+ * Instruction set selection for the SIMD kernels
+ * The choice is made by a load-time constructor, before any OpenMP team
+ * exists, so the kernels only ever read it.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "cpu.h"
+
+#ifdef CPU_X86_64
+
+static const char* const isa_names[] = {"sse2", "avx2", "avx512"};
+
+/* -1 until the constructor has run */
+static int selected_isa = -1;
+
+/* Widest instruction set usable on this CPU (and enabled by the OS) */
+static cpu_isa_t detect_isa(void) {
+    __builtin_cpu_init();
+    if (!__builtin_cpu_supports("avx2") || !__builtin_cpu_supports("fma")) {
+        return CPU_ISA_GENERIC;
+    }
+    return __builtin_cpu_supports("avx512f") ? CPU_ISA_AVX512 : CPU_ISA_AVX2;
+}
+
+/* Detected instruction set, capped by SYMNMF_ISA */
+static cpu_isa_t select_isa(void) {
+    const char* env;
+    cpu_isa_t best;
+    int isa;
+
+    best = detect_isa();
+    env = getenv(ISA_ENV);
+    if (env) {
+        for (isa = CPU_ISA_GENERIC; isa <= CPU_ISA_AVX512; isa++) {
+            if (strcmp(env, isa_names[isa]) == 0) {
+                return (cpu_isa_t)isa < best ? (cpu_isa_t)isa : best;
+            }
+        }
+    }
+    return best;
+}
+
+__attribute__((constructor))
+static void init_isa(void) {
+    selected_isa = (int)select_isa();
+}
+
+/* Instruction set chosen at load time */
+cpu_isa_t cpu_isa(void) {
+    /* Before the constructor has run, select without caching so concurrent callers never write */
+    return selected_isa < 0 ? select_isa() : (cpu_isa_t)selected_isa;
+}
+
+/* Name of an instruction set */
+const char* cpu_isa_name(cpu_isa_t isa) {
+    return isa_names[isa];
+}
+
+#else
+
+/* Only the baseline kernels exist */
+cpu_isa_t cpu_isa(void) {
+    return CPU_ISA_GENERIC;
+}
+
+/* Name of an instruction set */
+const char* cpu_isa_name(cpu_isa_t isa) {
+    (void)isa;
+    return "generic";
+}
+
+#endif /* CPU_X86_64 */
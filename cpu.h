@@ -0,0 +1,41 @@
+#ifndef CPU_H
+#define CPU_H
+
+/* Instruction set selection for the SIMD kernels */
+
+/* ISA-specific variants are only built for x86-64 with GCC-compatible compilers */
+#if defined(__GNUC__) && defined(__x86_64__)
+#define CPU_X86_64 1
+#endif
+
+/* Environment variable that caps the instruction set: sse2, avx2 or avx512 */
+#define ISA_ENV "SYMNMF_ISA"
+
+/*
+ * Instruction sets with a kernel variant
+ * CPU_ISA_GENERIC is the baseline build (SSE2 on x86-64, plain C elsewhere);
+ * CPU_ISA_AVX2 requires AVX2 and FMA, CPU_ISA_AVX512 additionally AVX-512F
+ */
+typedef enum cpu_isa_t {
+    CPU_ISA_GENERIC = 0,
+    CPU_ISA_AVX2 = 1,
+    CPU_ISA_AVX512 = 2
+} cpu_isa_t;
+
+/*
+ * Instruction set the kernels run with
+ * Chosen once when the program or module is loaded: the widest set the CPU
+ * and operating system support, lowered to the value of SYMNMF_ISA if that
+ * names a narrower one. Requests for unsupported sets are ignored.
+ * @return: Selected instruction set
+ */
+cpu_isa_t cpu_isa(void);
+
+/*
+ * Name of an instruction set as accepted by SYMNMF_ISA
+ * @param isa: Instruction set
+ * @return: "sse2", "avx2" or "avx512" ("generic" off x86-64)
+ */
+const char* cpu_isa_name(cpu_isa_t isa);
+
+#endif /* CPU_H */
\ No newline at end of file
@@ -0,0 +1,344 @@
+/*
+ * Parallel CSV reader
+ * The whole file is read into memory and cut into byte ranges that end
+ * at newlines. A first parallel pass counts the lines and the non-blank
+ * rows of every range; prefix sums of the counts give each range its
+ * first row and first line number, so after the matrix is allocated a
+ * second parallel pass parses every range straight into its own rows.
+ * Each range records its first error, and the error on the lowest line
+ * is reported, which is the one a sequential reader would have hit.
+ *
+ * Plain decimals whose digits form an integer below 2^53 and whose
+ * decimal exponent is within +-22 are converted with one exact multiply
+ * or divide, which is correctly rounded and therefore equal to strtod;
+ * anything else is handed to strtod.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include "csv.h"
+#include "parallel.h"
+
+/* Smallest byte range worth a separate work item */
+#define CSV_MIN_RANGE (1 << 20)
+
+/* Work items per thread, to even out ranges of unequal cost */
+#define CSV_RANGES_PER_THREAD 4
+
+/*
+ * Digits accumulated in an unsigned long without overflow, and the
+ * largest mantissa that converts to double exactly (2^53)
+ */
+#if ULONG_MAX / 1000000000UL / 1000000000UL >= 10UL
+#define FAST_DIGITS 19
+#define FAST_MANTISSA 9007199254740992UL
+#else
+#define FAST_DIGITS 9
+#define FAST_MANTISSA ULONG_MAX
+#endif
+
+/* Largest power of ten that is exact in a double */
+#define FAST_EXPONENT 22
+
+static const double powers_of_ten[FAST_EXPONENT + 1] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+/*
+ * One newline-aligned byte range of the file and its results
+ * @field begin: First byte
+ * @field end: One past the last byte (just after a newline, or the file end)
+ * @field lines: Lines that start in the range
+ * @field rows: Non-blank lines among them
+ * @field first_row: Matrix row of the first non-blank line
+ * @field first_line: Line number (from 1) of the first line
+ * @field error: First error in the range, line 0 if none
+ */
+typedef struct csv_range_t {
+    char* begin;
+    char* end;
+    size_t lines;
+    size_t rows;
+    size_t first_row;
+    size_t first_line;
+    csv_error_t error;
+} csv_range_t;
+
+/* Whether c is a blank that may surround a value */
+static int is_blank(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+/* End of the line starting at p: its newline, or end */
+static char* line_end(char* p, char* end) {
+    char* newline;
+
+    newline = (char*)memchr(p, '\n', (size_t)(end - p));
+    return newline ? newline : end;
+}
+
+/* Whether [p, end) holds only blanks */
+static int is_blank_line(const char* p, const char* end) {
+    while (p < end && is_blank(*p)) p++;
+    return p == end;
+}
+
+/* Set an error unless one is already recorded */
+static void set_error(csv_error_t* error, size_t line, const char* message) {
+    if (error->line == 0) {
+        error->line = line;
+        error->message = message;
+    }
+}
+
+/*
+ * Parse the number starting at p
+ * @return: First character after the number, or NULL if there is none
+ */
+static char* parse_number(char* p, double* value) {
+    char* start;
+    char* end;
+    char* dot;
+    unsigned long mantissa;
+    unsigned int digit;
+    double result;
+    int negative, digits, exponent, exp_value, exp_negative;
+
+    start = p;
+    negative = *p == '-';
+    if (*p == '-' || *p == '+') p++;
+    mantissa = 0;
+    digits = 0;
+    dot = NULL;
+    for (;; p++) {
+        digit = (unsigned int)(*p - '0');
+        if (digit < 10) {
+            mantissa = mantissa * 10 + digit;
+            digits++;
+        } else if (*p == '.' && !dot) {
+            dot = p;
+        } else {
+            break;
+        }
+    }
+    exponent = dot ? -(int)(p - dot - 1) : 0;
+    if (digits > 0 && (*p == 'e' || *p == 'E')) {
+        end = p + 1;
+        exp_negative = 0;
+        if (*end == '-' || *end == '+') exp_negative = *end++ == '-';
+        if (*end >= '0' && *end <= '9') {
+            exp_value = 0;
+            for (; *end >= '0' && *end <= '9'; end++) {
+                if (exp_value < 10000) exp_value = exp_value * 10 + (*end - '0');
+            }
+            exponent += exp_negative ? -exp_value : exp_value;
+            p = end;
+        }
+    }
+    if (digits == 0 || digits > FAST_DIGITS || mantissa > FAST_MANTISSA ||
+        exponent < -FAST_EXPONENT || exponent > FAST_EXPONENT ||
+        (*p != ',' && *p != '\0' && !is_blank(*p))) {
+        /* Long mantissas, large exponents, inf, nan, hex floats and garbage */
+        *value = strtod(start, &end);
+        return end == start ? NULL : end;
+    }
+    result = (double)mantissa;
+    if (exponent < 0) {
+        result /= powers_of_ten[-exponent];
+    } else {
+        result *= powers_of_ten[exponent];
+    }
+    *value = negative ? -result : result;
+    return p;
+}
+
+/*
+ * Parse one NUL-terminated line of exactly cols values into row
+ * @return: NULL on success, else the error message
+ */
+static const char* parse_line(char* line, double* row, size_t cols) {
+    size_t count;
+
+    count = 0;
+    for (;;) {
+        while (is_blank(*line)) line++;
+        if (count == cols) return "more values than in the first row";
+        line = parse_number(line, &row[count++]);
+        if (!line) return "not a number";
+        while (is_blank(*line)) line++;
+        if (*line == '\0') break;
+        if (*line++ != ',') return "not a number";
+    }
+    return count == cols ? NULL : "fewer values than in the first row";
+}
+
+/* Pass 1: count the lines and non-blank rows of a range */
+static void count_range(csv_range_t* range) {
+    char *p, *eol;
+
+    range->lines = 0;
+    range->rows = 0;
+    for (p = range->begin; p < range->end; p = eol + 1) {
+        eol = line_end(p, range->end);
+        range->lines++;
+        if (!is_blank_line(p, eol)) range->rows++;
+    }
+}
+
+/* Pass 2: parse the rows of a range into data */
+static void parse_range(csv_range_t* range, matrix_t* data) {
+    const char* message;
+    char *p, *eol;
+    size_t line, row;
+
+    line = range->first_line;
+    row = range->first_row;
+    for (p = range->begin; p < range->end; p = eol + 1, line++) {
+        eol = line_end(p, range->end);
+        if (is_blank_line(p, eol)) continue;
+        *eol = '\0';  /* The range owns its bytes; the buffer has a spare one at the end */
+        message = parse_line(p, MATRIX_ROW(data, row), data->cols);
+        if (message) {
+            set_error(&range->error, line, message);
+            return;
+        }
+        row++;
+    }
+}
+
+/* Values on the first non-blank line, or 0 if there is none */
+static size_t count_columns(const char* p, const char* end) {
+    const char* eol;
+    size_t cols;
+
+    for (; p < end; p = eol + 1) {
+        eol = (const char*)memchr(p, '\n', (size_t)(end - p));
+        if (!eol) eol = end;
+        if (is_blank_line(p, eol)) continue;
+        cols = 1;
+        for (; p < eol; p++) cols += *p == ',';
+        return cols;
+    }
+    return 0;
+}
+
+/* Read the whole file into a NUL-terminated buffer; returns NULL on failure */
+static char* read_file(const char* filename, size_t* size, csv_error_t* error) {
+    FILE* file;
+    char* buffer;
+    long length;
+
+    file = fopen(filename, "rb");
+    if (!file) {
+        set_error(error, 0, "cannot open file");
+        return NULL;
+    }
+    buffer = NULL;
+    if (fseek(file, 0, SEEK_END) == 0 && (length = ftell(file)) >= 0 && fseek(file, 0, SEEK_SET) == 0) {
+        buffer = (char*)malloc((size_t)length + 1);
+        if (buffer && fread(buffer, 1, (size_t)length, file) == (size_t)length) {
+            buffer[length] = '\0';
+            *size = (size_t)length;
+        } else {
+            free(buffer);
+            buffer = NULL;
+        }
+    }
+    fclose(file);
+    if (!buffer) set_error(error, 0, "cannot read file");
+    return buffer;
+}
+
+/* Cut [buffer, buffer + size) into about count ranges ending at newlines */
+static size_t split_ranges(char* buffer, size_t size, size_t count, csv_range_t* ranges) {
+    char *p, *end, *cut;
+    size_t r;
+
+    p = buffer;
+    end = buffer + size;
+    for (r = 0; r < count && p < end; r++) {
+        cut = r + 1 == count ? end : buffer + size / count * (r + 1);
+        if (cut < p) cut = p;
+        if (cut < end) {
+            cut = line_end(cut, end);
+            if (cut < end) cut++;
+        }
+        ranges[r].begin = p;
+        ranges[r].end = cut;
+        ranges[r].error.line = 0;
+        ranges[r].error.message = NULL;
+        p = cut;
+    }
+    return r;
+}
+
+/* Read a point file with parallel passes over newline-aligned ranges */
+matrix_t* csv_read(const char* filename, int num_threads, csv_error_t* error) {
+    csv_error_t local;
+    csv_range_t* ranges;
+    matrix_t* data;
+    char* buffer;
+    size_t size, count, num_ranges, rows, lines, cols, r;
+    int failed;
+
+    if (!error) error = &local;
+    error->line = 0;
+    error->message = NULL;
+    buffer = read_file(filename, &size, error);
+    if (!buffer) return NULL;
+    num_threads = resolve_num_threads(num_threads);
+    count = size / CSV_MIN_RANGE + 1;
+    if (count > (size_t)num_threads * CSV_RANGES_PER_THREAD) count = (size_t)num_threads * CSV_RANGES_PER_THREAD;
+    ranges = (csv_range_t*)malloc(count * sizeof(csv_range_t));
+    if (!ranges) {
+        free(buffer);
+        set_error(error, 0, "out of memory");
+        return NULL;
+    }
+    num_ranges = split_ranges(buffer, size, count, ranges);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 1) num_threads(num_threads)
+#endif
+    for (r = 0; r < num_ranges; r++) {
+        count_range(&ranges[r]);
+    }
+    /* Prefix sums give every range its first row and line */
+    rows = 0;
+    lines = 0;
+    for (r = 0; r < num_ranges; r++) {
+        ranges[r].first_row = rows;
+        ranges[r].first_line = lines + 1;
+        rows += ranges[r].rows;
+        lines += ranges[r].lines;
+    }
+    cols = count_columns(buffer, buffer + size);
+    data = rows ? matrix_create(rows, cols) : NULL;
+    if (data) {
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 1) num_threads(num_threads)
+#endif
+        for (r = 0; r < num_ranges; r++) {
+            parse_range(&ranges[r], data);
+        }
+    } else {
+        set_error(error, 0, rows ? "out of memory" : "no data");
+    }
+    /* Ranges are in line order, so the first failing one has the lowest line */
+    failed = data == NULL;
+    for (r = 0; r < num_ranges && !failed; r++) {
+        if (ranges[r].error.line) {
+            *error = ranges[r].error;
+            failed = 1;
+        }
+    }
+    free(ranges);
+    free(buffer);
+    if (failed) {
+        matrix_free(data);
+        return NULL;
+    }
+    return data;
+}
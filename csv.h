@@ -0,0 +1,35 @@
+#ifndef CSV_H
+#define CSV_H
+
+#include <stddef.h>
+#include "matrix.h"
+
+/* Comma-separated point file input */
+
+/*
+ * Where and why reading failed
+ * @field line: Line number (from 1) of the offending line, 0 if the
+ *              failure is not tied to a line (I/O, memory, empty file)
+ * @field message: Short description
+ */
+typedef struct csv_error_t {
+    size_t line;
+    const char* message;
+} csv_error_t;
+
+/*
+ * Read one point per line, coordinates separated by commas
+ * The file is parsed by several threads over newline-aligned byte ranges
+ * directly into the result; lines may be of any length. Blank lines are
+ * skipped, CR LF line ends and blanks around values are accepted, and
+ * every row must have as many values as the first. Numbers are parsed to
+ * the same double as strtod. Peak memory is the file size plus the matrix.
+ * @param filename: Name of input file
+ * @param num_threads: Threads to use, or 0 for SYMNMF_NUM_THREADS / OpenMP default
+ * @param error: Receives the first error in file order, may be NULL
+ * @return: Data matrix (n x d), or NULL if the file cannot be read, is
+ *          empty or malformed, or memory runs out
+ */
+matrix_t* csv_read(const char* filename, int num_threads, csv_error_t* error);
+
+#endif /* CSV_H */
@@ -0,0 +1,53 @@
+/*
+ * Pairwise distance kernels
+ * For wide points the distance tile is dominated by the d-long inner
+ * products, so they are computed as a small X_I X_J^T product: a 4x4
+ * block of dot products reuses every loaded coordinate four times and
+ * turns the phase compute-bound. Narrow points keep the exact difference
+ * loop, whose result does not suffer from cancellation. The tile kernel
+ * itself lives in kernels.inc and is built once per instruction set.
+ */
+
+#include <stdlib.h>
+#include "distance.h"
+#include "kernels.h"
+
+/* Squared Euclidean distance between two d-dimensional points */
+double squared_distance(const double* x, const double* y, size_t d) {
+    double sum, diff;
+    size_t k;
+
+    sum = 0.0;
+    for (k = 0; k < d; k++) {
+        diff = x[k] - y[k];
+        sum += diff * diff;
+    }
+    return sum;
+}
+
+/* Squared norm of every row */
+double* squared_norms(const matrix_t* points) {
+    double* norms;
+    const double* p;
+    double sum;
+    size_t i, k;
+
+    norms = (double*)malloc((points->rows ? points->rows : 1) * sizeof(double));
+    if (!norms) return NULL;
+    for (i = 0; i < points->rows; i++) {
+        p = MATRIX_ROW(points, i);
+        sum = 0.0;
+        for (k = 0; k < points->cols; k++) {
+            sum += p[k] * p[k];
+        }
+        norms[i] = sum;
+    }
+    return norms;
+}
+
+/* Squared distances of a rectangular block of point pairs */
+void squared_distance_tile(const matrix_t* points, const double* norms,
+                           size_t i0, size_t i1, size_t j0, size_t j1,
+                           double* tile, size_t ld) {
+    kernels()->distance_tile(points, norms, i0, i1, j0, j1, tile, ld);
+}
\ No newline at end of file
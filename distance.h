@@ -0,0 +1,48 @@
+#ifndef DISTANCE_H
+#define DISTANCE_H
+
+#include <stddef.h>
+#include "matrix.h"
+
+/* Pairwise distance kernels */
+
+/*
+ * Dimension from which squared_distance_tile switches from the direct
+ * difference loop to the dot-product form ||x||^2 + ||y||^2 - 2 x.y
+ */
+#define DISTANCE_GEMM_MIN_DIM 16
+
+/*
+ * Squared Euclidean distance between two points
+ * @param x: First point
+ * @param y: Second point
+ * @param d: Number of dimensions
+ * @return: Sum over k of (x[k] - y[k])^2
+ */
+double squared_distance(const double* x, const double* y, size_t d);
+
+/*
+ * Squared Euclidean norm of every point
+ * @param points: Input data points as n x d matrix
+ * @return: Newly allocated vector of n norms, or NULL if error occurs
+ */
+double* squared_norms(const matrix_t* points);
+
+/*
+ * Squared distances between points [i0, i1) and points [j0, j1)
+ * Uses the direct loop for d < DISTANCE_GEMM_MIN_DIM and a register-tiled
+ * X_I X_J^T product otherwise; negative round-off is clamped to zero
+ * @param points: Input data points as n x d matrix
+ * @param norms: Output of squared_norms for the same points
+ * @param i0: First row point
+ * @param i1: One past the last row point
+ * @param j0: First column point
+ * @param j1: One past the last column point
+ * @param tile: Receives distance (i, j) at tile[(i - i0) * ld + (j - j0)]
+ * @param ld: Row stride of tile in elements
+ */
+void squared_distance_tile(const matrix_t* points, const double* norms,
+                           size_t i0, size_t i1, size_t j0, size_t j1,
+                           double* tile, size_t ld);
+
+#endif /* DISTANCE_H */
\ No newline at end of file
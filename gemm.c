@@ -0,0 +1,310 @@
+/*
+ * Dense matrix products
+ * Two kernels back matrix_multiply_into: a row-panel kernel for skinny
+ * right-hand sides (W*H and H*(H^T H), where p is the number of clusters)
+ * and a packed kernel in the usual three-level blocking for everything
+ * else. Block sizes target a 32KB L1 and a 1MB L2. The inner kernels live
+ * in kernels.inc and run in the variant of the selected instruction set.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "gemm.h"
+#include "kernels.h"
+
+/* Cache blocks of the packed kernel: A block in L2, B sliver in L1 */
+#define MC GEMM_MC
+#define KC GEMM_KC
+#define NC 2048
+
+/* Products below this many multiply-adds are not worth packing */
+#define PACK_MIN_FLOPS 32768
+
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+
+/* Zero every element of C, leaving row padding untouched */
+static void zero_matrix(matrix_t* C) {
+    size_t i;
+
+    for (i = 0; i < C->rows; i++) {
+        memset(MATRIX_ROW(C, i), 0, C->cols * sizeof(double));
+    }
+}
+
+/* Reference i-k-j product, used for tiny shapes and when packing fails */
+static void gemm_simple(const matrix_t* A, const matrix_t* B, matrix_t* C) {
+    const double* a_row;
+    const double* b_row;
+    double* c_row;
+    double a_ik;
+    size_t i, j, k;
+
+    for (i = 0; i < A->rows; i++) {
+        a_row = MATRIX_ROW(A, i);
+        c_row = MATRIX_ROW(C, i);
+        for (k = 0; k < A->cols; k++) {
+            a_ik = a_row[k];
+            b_row = MATRIX_ROW(B, k);
+            for (j = 0; j < B->cols; j++) {
+                c_row[j] += a_ik * b_row[j];
+            }
+        }
+    }
+}
+
+/* Pack an mc x kc block of A into MR-row slivers, column by column, zero padded */
+static void pack_a(const matrix_t* A, size_t ic, size_t pc, size_t mc, size_t kc, double* dst) {
+    const double* src;
+    size_t ir, r, l, rows;
+
+    for (ir = 0; ir < mc; ir += MR) {
+        rows = MIN(MR, mc - ir);
+        for (r = 0; r < MR; r++) {
+            if (r < rows) {
+                src = MATRIX_ROW(A, ic + ir + r) + pc;
+                for (l = 0; l < kc; l++) dst[l * MR + r] = src[l];
+            } else {
+                for (l = 0; l < kc; l++) dst[l * MR + r] = 0.0;
+            }
+        }
+        dst += MR * kc;
+    }
+}
+
+/* Pack a kc x nc block of B into NR-column slivers, row by row, zero padded */
+static void pack_b(const matrix_t* B, size_t pc, size_t jc, size_t kc, size_t nc, double* dst) {
+    const double* src;
+    size_t jr, l, c, cols;
+
+    for (jr = 0; jr < nc; jr += NR) {
+        cols = MIN(NR, nc - jr);
+        for (l = 0; l < kc; l++) {
+            src = MATRIX_ROW(B, pc + l) + jc + jr;
+            for (c = 0; c < cols; c++) dst[c] = src[c];
+            for (; c < NR; c++) dst[c] = 0.0;
+            dst += NR;
+        }
+    }
+}
+
+/* C += A * B for the packed kc x nc block (pc, jc) of B, packing A an MC x kc block at a time */
+static void multiply_block(const kernel_table_t* kern, const matrix_t* A, const double* b_pack,
+                           size_t pc, size_t jc, size_t kc, size_t nc, double* a_pack, matrix_t* C) {
+    size_t ic, ir, jr, mc;
+
+    for (ic = 0; ic < A->rows; ic += MC) {
+        mc = MIN(MC, A->rows - ic);
+        pack_a(A, ic, pc, mc, kc, a_pack);
+        for (jr = 0; jr < nc; jr += NR) {
+            for (ir = 0; ir < mc; ir += MR) {
+                kern->gemm_micro(kc, a_pack + ir * kc, b_pack + jr * kc,
+                                 MATRIX_ROW(C, ic + ir) + jc + jr, C->stride,
+                                 MIN(MR, mc - ir), MIN(NR, nc - jr));
+            }
+        }
+    }
+}
+
+/* Packed, blocked product for general shapes; returns 0 if buffers cannot be allocated */
+static int gemm_packed(const matrix_t* A, const matrix_t* B, matrix_t* C) {
+    const kernel_table_t* kern;
+    double* a_pack;
+    double* b_pack;
+    size_t m, p, jc, pc, nc, kc;
+
+    m = A->cols;
+    p = B->cols;
+    a_pack = (double*)malloc(MC * KC * sizeof(double));
+    b_pack = (double*)malloc(KC * ((MIN(NC, p) + NR - 1) / NR * NR) * sizeof(double));
+    if (!a_pack || !b_pack) {
+        free(a_pack);
+        free(b_pack);
+        return 0;
+    }
+    kern = kernels();
+    for (jc = 0; jc < p; jc += NC) {
+        nc = MIN(NC, p - jc);
+        for (pc = 0; pc < m; pc += KC) {
+            kc = MIN(KC, m - pc);
+            pack_b(B, pc, jc, kc, nc, b_pack);
+            multiply_block(kern, A, b_pack, pc, jc, kc, nc, a_pack, C);
+        }
+    }
+    free(a_pack);
+    free(b_pack);
+    return 1;
+}
+
+/* Allocate the packed form of a rows x cols right-hand side in one allocation */
+gemm_prepacked_t* gemm_prepacked_create(size_t rows, size_t cols) {
+    return gemm_prepacked_create_array(1, rows, cols);
+}
+
+/* Headers first, then count data blocks, all in one allocation */
+gemm_prepacked_t* gemm_prepacked_create_array(size_t count, size_t rows, size_t cols) {
+    gemm_prepacked_t* B;
+    size_t padded_cols, size, i;
+
+    padded_cols = (cols + NR - 1) / NR * NR;
+    if (padded_cols < cols || (padded_cols && rows > ((size_t)-1 / sizeof(double)) / padded_cols)) return NULL;
+    size = rows * padded_cols;
+    if (count == 0 || count > ((size_t)-1 / 2 / sizeof(double)) / (size + sizeof(gemm_prepacked_t))) return NULL;
+    B = (gemm_prepacked_t*)malloc(count * sizeof(gemm_prepacked_t) + (count * size + 1) * sizeof(double));
+    if (!B) return NULL;
+    for (i = 0; i < count; i++) {
+        B[i].data = (double*)(B + count) + i * size;
+        B[i].rows = rows;
+        B[i].cols = cols;
+        B[i].padded_cols = padded_cols;
+    }
+    return B;
+}
+
+/* Free a prepacked right-hand side */
+void gemm_prepacked_free(gemm_prepacked_t* B) {
+    free(B);
+}
+
+/*
+ * Pack rows [first, last) of B where pack_b would put them
+ * Block (pc, jc) starts after the full KC-row blocks above it and the
+ * full NC-column blocks left of it, and holds kc-row NR-column slivers
+ */
+void gemm_prepack_rows(const matrix_t* B, size_t first, size_t last, gemm_prepacked_t* packed) {
+    const double* src;
+    double* dst;
+    size_t r, pc, kc, jc, nc, jr, c, col;
+
+    for (r = first; r < last; r++) {
+        src = MATRIX_ROW(B, r);
+        pc = r / KC * KC;
+        kc = MIN(KC, packed->rows - pc);
+        for (jc = 0; jc < packed->cols; jc += NC) {
+            nc = MIN(NC, packed->cols - jc);
+            for (jr = 0; jr < nc; jr += NR) {
+                dst = packed->data + pc * packed->padded_cols + kc * jc + jr * kc + (r - pc) * NR;
+                for (c = 0; c < NR; c++) {
+                    col = jc + jr + c;
+                    dst[c] = jr + c < nc ? src[col] : 0.0;
+                }
+            }
+        }
+    }
+}
+
+/* Multiply A by a prepacked B with the packed kernel, in the order of gemm_packed */
+void matrix_multiply_prepacked_into(const matrix_t* A, const gemm_prepacked_t* B, double* a_scratch,
+                                    matrix_t* C) {
+    const kernel_table_t* kern;
+    size_t m, p, jc, pc, nc, kc;
+
+    m = B->rows;
+    p = B->cols;
+    zero_matrix(C);
+    kern = kernels();
+    for (jc = 0; jc < p; jc += NC) {
+        nc = MIN(NC, p - jc);
+        for (pc = 0; pc < m; pc += KC) {
+            kc = MIN(KC, m - pc);
+            multiply_block(kern, A, B->data + pc * B->padded_cols + kc * jc, pc, jc, kc, nc, a_scratch, C);
+        }
+    }
+}
+
+/* Multiply A(n x m) by B(m x p) into C, choosing a kernel by shape */
+void matrix_multiply_into(const matrix_t* A, const matrix_t* B, matrix_t* C) {
+    zero_matrix(C);
+    if (B->cols <= SKINNY_COLS) {
+        kernels()->gemm_skinny(A, B, C);
+    } else if ((double)A->rows * A->cols * B->cols < PACK_MIN_FLOPS || !gemm_packed(A, B, C)) {
+        gemm_simple(A, B, C);
+    }
+}
+
+/* Multiply single-precision A by B one SKINNY_COLS-wide panel of B at a time */
+void matrix_multiply_f32_into(const fmatrix_t* A, const matrix_t* B, matrix_t* C) {
+    matrix_t B_panel, C_panel;
+    size_t j;
+
+    zero_matrix(C);
+    for (j = 0; j < B->cols; j += SKINNY_COLS) {
+        B_panel = *B;
+        B_panel.data += j;
+        B_panel.cols = MIN(SKINNY_COLS, B->cols - j);
+        C_panel = *C;
+        C_panel.data += j;
+        C_panel.cols = B_panel.cols;
+        kernels()->gemm_skinny_f32(A, &B_panel, &C_panel);
+    }
+}
+
+/* C += A * B, or A^T * B if transposed, one SKINNY_COLS-wide panel of B at a time */
+static void gemm_skinny_panels(const matrix_t* A, const matrix_t* B, matrix_t* C, int transposed) {
+    matrix_t B_panel, C_panel;
+    size_t j;
+
+    for (j = 0; j < B->cols; j += SKINNY_COLS) {
+        B_panel = *B;
+        B_panel.data += j;
+        B_panel.cols = MIN(SKINNY_COLS, B->cols - j);
+        C_panel = *C;
+        C_panel.data += j;
+        C_panel.cols = B_panel.cols;
+        if (transposed) {
+            kernels()->gemm_skinny_t(A, &B_panel, &C_panel);
+        } else {
+            kernels()->gemm_skinny(A, &B_panel, &C_panel);
+        }
+    }
+}
+
+/* C += A * B through the row-panel kernel */
+void matrix_multiply_add_into(const matrix_t* A, const matrix_t* B, matrix_t* C) {
+    gemm_skinny_panels(A, B, C, 0);
+}
+
+/* Multiply rows [first, last) of packed W by B tile by tile */
+void packed_multiply_rows_into(const packed_matrix_t* W, const matrix_t* B,
+                               size_t first, size_t last, matrix_t* C) {
+    matrix_t A, B_rows, C_rows;
+    size_t I, J, i0, i1, width;
+
+    zero_matrix(C);
+    A.stride = PACKED_BLOCK;
+    for (I = first / PACKED_BLOCK; I * PACKED_BLOCK < last; I++) {
+        i0 = first > I * PACKED_BLOCK ? first : I * PACKED_BLOCK;
+        i1 = MIN(last, (I + 1) * PACKED_BLOCK);
+        C_rows = matrix_rows(C, i0 - first, i1 - first);
+        for (J = 0; J < W->blocks; J++) {
+            width = MIN(PACKED_BLOCK, W->n - J * PACKED_BLOCK);
+            B_rows = matrix_rows(B, J * PACKED_BLOCK, J * PACKED_BLOCK + width);
+            if (J < I) {
+                /* Rows i0..i1 of this tile are columns of the stored tile (J, I) */
+                A.data = PACKED_TILE(W, J, I) + (i0 - I * PACKED_BLOCK);
+                A.rows = width;
+                A.cols = i1 - i0;
+                gemm_skinny_panels(&A, &B_rows, &C_rows, 1);
+            } else {
+                A.data = PACKED_TILE(W, I, J) + (i0 - I * PACKED_BLOCK) * PACKED_BLOCK;
+                A.rows = i1 - i0;
+                A.cols = width;
+                gemm_skinny_panels(&A, &B_rows, &C_rows, 0);
+            }
+        }
+    }
+}
+
+/* Compute G = A^T A from its upper triangle */
+void gram_matrix_into(const matrix_t* A, matrix_t* G) {
+    size_t k, i, j;
+
+    k = A->cols;
+    zero_matrix(G);
+    kernels()->gram_upper(A, G);
+    /* Mirror into the lower triangle */
+    for (i = 0; i < k; i++) {
+        for (j = 0; j < i; j++) {
+            MATRIX_AT(G, i, j) = MATRIX_AT(G, j, i);
+        }
+    }
+}
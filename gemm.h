@@ -0,0 +1,127 @@
+#ifndef GEMM_H
+#define GEMM_H
+
+#include "matrix.h"
+
+/* Dense matrix products */
+
+/* Cache blocks of the packed kernel: rows of A and rows of B (inner dimension) per packed block */
+#define GEMM_MC 128
+#define GEMM_KC 256
+
+/* Doubles of caller scratch matrix_multiply_prepacked_into packs blocks of A into */
+#define GEMM_A_SCRATCH (GEMM_MC * GEMM_KC)
+
+/*
+ * Right-hand side packed ahead of time for the packed kernel
+ * B is laid out as the packed kernel reads it, in GEMM_KC-row blocks of
+ * zero-padded column slivers, so products of many row blocks of A by the
+ * same B (one per thread or per chunk) share one packing of B
+ * @field data: Packed elements (rows x padded_cols)
+ * @field rows: Number of rows of B
+ * @field cols: Number of columns of B
+ * @field padded_cols: Columns rounded up to a whole number of slivers
+ */
+typedef struct gemm_prepacked_t {
+    double* data;
+    size_t rows;
+    size_t cols;
+    size_t padded_cols;
+} gemm_prepacked_t;
+
+/*
+ * Multiply two matrices into a preallocated result: C = A * B
+ * Uses a row-panel kernel when B is skinny (few columns) and a packed,
+ * cache-blocked, register-tiled kernel otherwise
+ * @param A: First matrix (n x m)
+ * @param B: Second matrix (m x p)
+ * @param C: Result matrix (n x p), overwritten, must not alias A or B
+ */
+void matrix_multiply_into(const matrix_t* A, const matrix_t* B, matrix_t* C);
+
+/*
+ * Allocate the packed form of a right-hand side in one allocation
+ * @param rows: Number of rows of B
+ * @param cols: Number of columns of B
+ * @return: New uninitialized packed B, or NULL if error occurs
+ */
+gemm_prepacked_t* gemm_prepacked_create(size_t rows, size_t cols);
+
+/*
+ * Allocate count packed right-hand sides of one shape in one allocation
+ * @param count: Number of packed matrices
+ * @param rows: Number of rows of each B
+ * @param cols: Number of columns of each B
+ * @return: Array of count uninitialized packed B, freed with gemm_prepacked_free, or NULL if error occurs
+ */
+gemm_prepacked_t* gemm_prepacked_create_array(size_t count, size_t rows, size_t cols);
+
+/*
+ * Free a packed right-hand side (NULL is ignored)
+ * @param B: The packed B to free
+ */
+void gemm_prepacked_free(gemm_prepacked_t* B);
+
+/*
+ * Pack rows [first, last) of B; disjoint row ranges may be packed
+ * separately, e.g. by different threads
+ * @param B: Matrix of the shape of packed
+ * @param first: First row to pack
+ * @param last: One past the last row to pack
+ * @param packed: Receives the rows
+ */
+void gemm_prepack_rows(const matrix_t* B, size_t first, size_t last, gemm_prepacked_t* packed);
+
+/*
+ * Multiply by a prepacked right-hand side: C = A * B
+ * Performs the operations of the packed kernel of matrix_multiply_into
+ * without allocating or packing B
+ * @param A: First matrix (n x m)
+ * @param B: Packed second matrix (m x p)
+ * @param a_scratch: Scratch of GEMM_A_SCRATCH doubles, one per concurrent call
+ * @param C: Result matrix (n x p), overwritten, must not alias A
+ */
+void matrix_multiply_prepacked_into(const matrix_t* A, const gemm_prepacked_t* B, double* a_scratch,
+                                    matrix_t* C);
+
+/*
+ * Multiply a single-precision matrix by a double one: C = A * B
+ * Elements of A are widened on load and all sums are kept in double;
+ * B is processed in panels of up to 16 columns by the row-panel kernel
+ * @param A: First matrix (n x m), single precision
+ * @param B: Second matrix (m x p)
+ * @param C: Result matrix (n x p), overwritten, must not alias B
+ */
+void matrix_multiply_f32_into(const fmatrix_t* A, const matrix_t* B, matrix_t* C);
+
+/*
+ * Accumulate C += A * B in the row-panel kernel, SKINNY_COLS columns of B
+ * at a time; meant for short-lived tiles of A that are not worth packing
+ * @param A: First matrix (n x m)
+ * @param B: Second matrix (m x p)
+ * @param C: Result matrix (n x p), added to, must not alias A or B
+ */
+void matrix_multiply_add_into(const matrix_t* A, const matrix_t* B, matrix_t* C);
+
+/*
+ * Multiply rows [first, last) of a packed symmetric matrix by B
+ * Each tile meets the matching PACKED_BLOCK rows of B in the row-panel
+ * kernel; tiles below the diagonal go through its transposed variant,
+ * which reads the stored tile down its columns
+ * @param W: Packed symmetric matrix (n x n)
+ * @param B: Second matrix (n x p)
+ * @param first: First row of W to multiply
+ * @param last: One past the last row of W to multiply
+ * @param C: Result matrix ((last - first) x p), overwritten, must not alias B
+ */
+void packed_multiply_rows_into(const packed_matrix_t* W, const matrix_t* B,
+                               size_t first, size_t last, matrix_t* C);
+
+/*
+ * Compute the Gram matrix A^T A into a preallocated result
+ * @param A: Input matrix (n x k), typically tall and skinny
+ * @param G: Result matrix (k x k), overwritten
+ */
+void gram_matrix_into(const matrix_t* A, matrix_t* G);
+
+#endif /* GEMM_H */
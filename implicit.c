@@ -0,0 +1,158 @@
+/*
+ * Matrix-free normalized similarity matrix
+ * W is never stored: every product evaluates
+ * exp(-||xi - xj||^2 / 2) * D^-1/2[i] * D^-1/2[j] tile by tile with the
+ * distance and exp kernels and immediately multiplies the tile into H
+ * with the GEMM row-panel kernel. Each product costs as much as building
+ * W once, which is the price of O(n * d) memory.
+ */
+
+#include <stdlib.h>
+#include <math.h>
+#include "implicit.h"
+#include "distance.h"
+#include "gemm.h"
+#include "kernels.h"
+#include "vexp.h"
+#include "parallel.h"
+
+/*
+ * Tile of W evaluated at once; 16 x 256 doubles fit in L1. A tile spans
+ * one SKINNY_KC block of the row-panel kernel, so for k <= SKINNY_COLS
+ * W*H is summed exactly as the dense product sums it
+ */
+#define IMPLICIT_ROWS 16
+#define IMPLICIT_COLS SKINNY_KC
+
+/* Evaluate exp(-||xi - xj||^2 / 2) for rows [bi, i_end) and columns [bj, j_end) */
+static void similarity_tile(const implicit_affinity_t* W, size_t bi, size_t i_end,
+                            size_t bj, size_t j_end, double tile[IMPLICIT_ROWS][IMPLICIT_COLS]) {
+    size_t i, j;
+
+    squared_distance_tile(W->points, W->norms, bi, i_end, bj, j_end, tile[0], IMPLICIT_COLS);
+    for (i = 0; i < i_end - bi; i++) {
+        for (j = 0; j < j_end - bj; j++) tile[i][j] *= -0.5;
+        vexp(tile[i], tile[i], j_end - bj);
+    }
+}
+
+/*
+ * Sum the rows of the similarity matrix into degree
+ * Row sums in column order over the same distance tiles the dense
+ * similarity matrix uses, so the degrees match it bit for bit
+ */
+static void fill_degrees(const implicit_affinity_t* W, double* degree, int num_threads) {
+    size_t n, bi;
+
+    n = W->n;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) num_threads(num_threads)
+#endif
+    for (bi = 0; bi < n; bi += IMPLICIT_ROWS) {
+        double tile[IMPLICIT_ROWS][IMPLICIT_COLS];
+        double sums[IMPLICIT_ROWS];
+        size_t bj, i, j, i_end, j_end;
+
+        i_end = bi + IMPLICIT_ROWS < n ? bi + IMPLICIT_ROWS : n;
+        for (i = bi; i < i_end; i++) sums[i - bi] = 0.0;
+        for (bj = 0; bj < n; bj += IMPLICIT_COLS) {
+            j_end = bj + IMPLICIT_COLS < n ? bj + IMPLICIT_COLS : n;
+            similarity_tile(W, bi, i_end, bj, j_end, tile);
+            for (i = bi; i < i_end; i++) {
+                for (j = bj; j < j_end; j++) {
+                    if (j != i) sums[i - bi] += tile[i - bi][j - bj];
+                }
+            }
+        }
+        for (i = bi; i < i_end; i++) {
+            degree[i] = sums[i - bi];
+        }
+    }
+    (void)num_threads;
+}
+
+/* Compute D^-1/2 and wrap the points */
+implicit_affinity_t* implicit_affinity_create(const matrix_t* points, int num_threads) {
+    implicit_affinity_t* W;
+    size_t n, i;
+
+    n = points->rows;
+    W = (implicit_affinity_t*)malloc(sizeof(implicit_affinity_t));
+    if (!W) return NULL;
+    W->inv_sqrt_degree = (double*)malloc((n ? n : 1) * sizeof(double));
+    W->norms = squared_norms(points);
+    if (!W->inv_sqrt_degree || !W->norms) {
+        implicit_affinity_free(W);
+        return NULL;
+    }
+    W->points = points;
+    W->n = n;
+    fill_degrees(W, W->inv_sqrt_degree, resolve_num_threads(num_threads));
+    for (i = 0; i < n; i++) {
+        W->inv_sqrt_degree[i] = 1.0 / sqrt(W->inv_sqrt_degree[i]);
+    }
+    return W;
+}
+
+/* Degrees of the points without storing the similarity matrix */
+int implicit_degrees(const matrix_t* points, double* degree, int num_threads) {
+    implicit_affinity_t W;
+
+    W.points = points;
+    W.n = points->rows;
+    W.inv_sqrt_degree = NULL;
+    W.norms = squared_norms(points);
+    if (!W.norms) return 0;
+    fill_degrees(&W, degree, resolve_num_threads(num_threads));
+    free(W.norms);
+    return 1;
+}
+
+/* Free the degree and norm vectors and the wrapper */
+void implicit_affinity_free(implicit_affinity_t* W) {
+    if (W) {
+        free(W->inv_sqrt_degree);
+        free(W->norms);
+        free(W);
+    }
+}
+
+/* Rows [first, last) of W * H with W evaluated one tile at a time */
+void implicit_multiply_rows(const implicit_affinity_t* W, const matrix_t* H,
+                            size_t first, size_t last, matrix_t* out) {
+    double tile[IMPLICIT_ROWS][IMPLICIT_COLS];
+    matrix_t tile_view, H_rows, out_rows;
+    double* o_row;
+    double scale_i;
+    size_t n, k, bi, bj, i, j, c, i_end, j_end;
+
+    n = W->n;
+    k = H->cols;
+    for (i = 0; i < out->rows; i++) {
+        o_row = MATRIX_ROW(out, i);
+        for (c = 0; c < k; c++) o_row[c] = 0.0;
+    }
+    tile_view.data = tile[0];
+    tile_view.stride = IMPLICIT_COLS;
+    for (bi = first; bi < last; bi += IMPLICIT_ROWS) {
+        i_end = bi + IMPLICIT_ROWS < last ? bi + IMPLICIT_ROWS : last;
+        out_rows = matrix_rows(out, bi - first, i_end - first);
+        for (bj = 0; bj < n; bj += IMPLICIT_COLS) {
+            j_end = bj + IMPLICIT_COLS < n ? bj + IMPLICIT_COLS : n;
+            /* Evaluate the tile of W */
+            similarity_tile(W, bi, i_end, bj, j_end, tile);
+            for (i = bi; i < i_end; i++) {
+                scale_i = W->inv_sqrt_degree[i];
+                for (j = bj; j < j_end; j++) {
+                    tile[i - bi][j - bj] = i == j ? 0.0 :
+                        tile[i - bi][j - bj] * (scale_i * W->inv_sqrt_degree[j]);
+                }
+            }
+            /* Multiply it into the matching rows of H */
+            tile_view.rows = i_end - bi;
+            tile_view.cols = j_end - bj;
+            H_rows = matrix_rows(H, bj, j_end);
+            matrix_multiply_add_into(&tile_view, &H_rows, &out_rows);
+        }
+    }
+}
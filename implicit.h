@@ -0,0 +1,60 @@
+#ifndef IMPLICIT_H
+#define IMPLICIT_H
+
+#include <stddef.h>
+#include "matrix.h"
+
+/* Matrix-free normalized similarity matrix */
+
+/*
+ * W = D^-1/2 A D^-1/2 represented by the points and D^-1/2 only
+ * Entries of W are recomputed on demand, so memory is O(n * d)
+ * @field points: Input data points (n x d), borrowed
+ * @field inv_sqrt_degree: D^-1/2 diagonal (n entries), owned
+ * @field norms: Squared norms of the points (n entries), owned
+ * @field n: Number of points
+ */
+typedef struct implicit_affinity_t {
+    const matrix_t* points;
+    double* inv_sqrt_degree;
+    double* norms;
+    size_t n;
+} implicit_affinity_t;
+
+/*
+ * Compute the degree vector of the points and wrap them as a matrix-free W
+ * @param points: Input data points (n x d), which must outlive the result
+ * @param num_threads: Threads to use, or 0 for SYMNMF_NUM_THREADS / OpenMP default
+ * @return: New matrix-free W, or NULL if error occurs
+ */
+implicit_affinity_t* implicit_affinity_create(const matrix_t* points, int num_threads);
+
+/*
+ * Compute the degree vector (row sums of the similarity matrix) tile by tile
+ * The similarity matrix is never stored and the sums equal those of the
+ * dense path bit for bit
+ * @param points: Input data points (n x d)
+ * @param degree: Receives the degrees (n entries)
+ * @param num_threads: Threads to use, or 0 for SYMNMF_NUM_THREADS / OpenMP default
+ * @return: 1 on success, 0 if error occurs
+ */
+int implicit_degrees(const matrix_t* points, double* degree, int num_threads);
+
+/*
+ * Free a matrix-free W (NULL is ignored); the points are not freed
+ * @param W: The matrix-free W to free
+ */
+void implicit_affinity_free(implicit_affinity_t* W);
+
+/*
+ * Compute rows [first, last) of W * H, evaluating W tile by tile
+ * @param W: Matrix-free W (n x n)
+ * @param H: Dense matrix (n x k)
+ * @param first: First row of the product
+ * @param last: One past the last row of the product
+ * @param out: Receives the rows ((last - first) x k), overwritten
+ */
+void implicit_multiply_rows(const implicit_affinity_t* W, const matrix_t* H,
+                            size_t first, size_t last, matrix_t* out);
+
+#endif /* IMPLICIT_H */
\ No newline at end of file
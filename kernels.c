@@ -0,0 +1,69 @@
+/*
+ * Per-ISA instantiation of the hot kernels
+ * kernels.inc is compiled three times: for the baseline target, for AVX2
+ * with FMA and for AVX-512F (512-bit vectors preferred). Floating-point
+ * contraction is disabled by the build, so the wider variants only change
+ * how many elements an instruction handles, not the rounding of any result.
+ * That is deliberate: every ISA gives bit-identical output, so no kernel
+ * emits FMA by default. Building with -DSYMNMF_FMA makes the GEMM
+ * micro-kernel of the AVX2 and AVX-512 variants fuse its multiply-adds
+ * (KERNEL_MADD); results then differ from SSE2 in the last bits.
+ */
+
+#include <stddef.h>
+#include "kernels.h"
+#include "cpu.h"
+#include "distance.h"
+
+#ifdef CPU_X86_64
+#define KERNEL_NAME "sse2"
+#else
+#define KERNEL_NAME "generic"
+#endif
+#define KERNEL(name) name##_generic
+#define KERNEL_MADD(acc, a, b) ((acc) + (a) * (b))
+#include "kernels.inc"
+#undef KERNEL
+#undef KERNEL_NAME
+
+#ifdef SYMNMF_FMA
+#undef KERNEL_MADD
+#define KERNEL_MADD(acc, a, b) __builtin_fma(a, b, acc)
+#endif
+
+#ifdef CPU_X86_64
+
+#pragma GCC push_options
+#pragma GCC target("avx2,fma")
+#define KERNEL_NAME "avx2"
+#define KERNEL(name) name##_avx2
+#include "kernels.inc"
+#undef KERNEL
+#undef KERNEL_NAME
+#pragma GCC pop_options
+
+#pragma GCC push_options
+#pragma GCC target("avx512f,avx2,fma,prefer-vector-width=512")
+#define KERNEL_NAME "avx512"
+#define KERNEL(name) name##_avx512
+#include "kernels.inc"
+#undef KERNEL
+#undef KERNEL_NAME
+#pragma GCC pop_options
+
+#endif /* CPU_X86_64 */
+
+/* Table matching the selected instruction set */
+const kernel_table_t* kernels(void) {
+#ifdef CPU_X86_64
+    switch (cpu_isa()) {
+    case CPU_ISA_AVX512:
+        return &table_avx512;
+    case CPU_ISA_AVX2:
+        return &table_avx2;
+    default:
+        break;
+    }
+#endif
+    return &table_generic;
+}
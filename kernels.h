@@ -0,0 +1,57 @@
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include <stddef.h>
+#include "matrix.h"
+
+/* Hot inner kernels, built once per instruction set and picked at run time */
+
+/* Right-hand sides with at most this many columns use the row-panel GEMM kernel */
+#define SKINNY_COLS 16
+/* Rows of B (inner dimension) kept hot in L1 by the row-panel kernel */
+#define SKINNY_KC 256
+
+/* Register tile of the packed GEMM kernel */
+#define MR 4
+#define NR 8
+
+/*
+ * One variant of every kernel, all compiled from kernels.inc
+ * Variants perform the same floating-point operations in the same order,
+ * so they return identical results.
+ * @field name: Instruction set name, as accepted by SYMNMF_ISA
+ * @field distance_tile: Body of squared_distance_tile (same arguments)
+ * @field gemm_skinny: C += A * B for B with at most SKINNY_COLS columns
+ * @field gemm_skinny_t: gemm_skinny for C += A^T * B
+ * @field gemm_skinny_f32: gemm_skinny with a single-precision A
+ * @field gemm_micro: MR x NR tile C[0:mr, 0:nr] += Ap * Bp of packed slivers
+ *                    over kc steps; c has row stride ldc
+ * @field gram_upper: Adds the upper triangle of A^T A to G
+ * @field multiplicative_update: H_next = H .* (1 - beta + beta * WH ./ HHtH)
+ *                               over all rows of the views; returns the
+ *                               squared Frobenius norm of H_next - H
+ * @field squared_difference: Squared Frobenius norm of A - B
+ */
+typedef struct kernel_table_t {
+    const char* name;
+    void (*distance_tile)(const matrix_t* points, const double* norms,
+                          size_t i0, size_t i1, size_t j0, size_t j1,
+                          double* tile, size_t ld);
+    void (*gemm_skinny)(const matrix_t* A, const matrix_t* B, matrix_t* C);
+    void (*gemm_skinny_t)(const matrix_t* A, const matrix_t* B, matrix_t* C);
+    void (*gemm_skinny_f32)(const fmatrix_t* A, const matrix_t* B, matrix_t* C);
+    void (*gemm_micro)(size_t kc, const double* a, const double* b,
+                       double* c, size_t ldc, size_t mr, size_t nr);
+    void (*gram_upper)(const matrix_t* A, matrix_t* G);
+    double (*multiplicative_update)(const matrix_t* H, const matrix_t* WH,
+                                    const matrix_t* HHtH, matrix_t* H_next, double beta);
+    double (*squared_difference)(const matrix_t* A, const matrix_t* B);
+} kernel_table_t;
+
+/*
+ * Kernels for the instruction set selected by cpu_isa()
+ * @return: Static kernel table
+ */
+const kernel_table_t* kernels(void);
+
+#endif /* KERNELS_H */
\ No newline at end of file
@@ -0,0 +1,285 @@
+/*
+ * Sparse k-nearest-neighbor similarity graphs
+ * Neighbor search is exact and brute force: every pair is measured, in
+ * KNN_TILE x KNN_TILE tiles of squared_distance_tile (the kernel behind
+ * sym), so time is O(n^2 * d) and practical up to some tens of thousands
+ * of points. Only O(n * neighbors) results are kept, so memory no longer
+ * grows with n^2.
+ */
+
+#include <stdlib.h>
+#include <math.h>
+#include "knn.h"
+#include "distance.h"
+#include "vexp.h"
+#include "parallel.h"
+
+#define KNN_TILE 64  /* Side of the distance tiles scanned by find_neighbors */
+#define KNN_EXP_CHUNK 4096  /* Similarities exponentiated per work item */
+
+/* One stored entry of a row while the graph is symmetrized */
+typedef struct knn_edge_t {
+    size_t col;
+    double value;
+} knn_edge_t;
+
+/* (dist_a, a) orders before (dist_b, b); the index breaks ties */
+static int closer(double dist_a, size_t a, double dist_b, size_t b) {
+    return dist_a < dist_b || (dist_a == dist_b && a < b);
+}
+
+/* Restore the max-heap property below position pos */
+static void sift_down(double* dist, size_t* idx, size_t count, size_t pos) {
+    size_t child, largest;
+    double tmp_dist;
+    size_t tmp_idx;
+
+    for (;;) {
+        largest = pos;
+        child = 2 * pos + 1;
+        if (child < count && closer(dist[largest], idx[largest], dist[child], idx[child])) {
+            largest = child;
+        }
+        child++;
+        if (child < count && closer(dist[largest], idx[largest], dist[child], idx[child])) {
+            largest = child;
+        }
+        if (largest == pos) return;
+        tmp_dist = dist[pos]; dist[pos] = dist[largest]; dist[largest] = tmp_dist;
+        tmp_idx = idx[pos]; idx[pos] = idx[largest]; idx[largest] = tmp_idx;
+        pos = largest;
+    }
+}
+
+/* Restore the max-heap property above position pos */
+static void sift_up(double* dist, size_t* idx, size_t pos) {
+    size_t parent;
+    double tmp_dist;
+    size_t tmp_idx;
+
+    while (pos > 0) {
+        parent = (pos - 1) / 2;
+        if (!closer(dist[parent], idx[parent], dist[pos], idx[pos])) return;
+        tmp_dist = dist[pos]; dist[pos] = dist[parent]; dist[parent] = tmp_dist;
+        tmp_idx = idx[pos]; idx[pos] = idx[parent]; idx[parent] = tmp_idx;
+        pos = parent;
+    }
+}
+
+/*
+ * Find the k nearest other points of every point
+ * Row i of dist/idx (k entries each) receives the neighbors of point i in
+ * max-heap order. Each block of KNN_TILE rows is measured against every
+ * column block by one thread, so any thread count gives the same neighbor
+ * sets, and every distance is the value sym computes for that pair.
+ * Returns 0 if the point norms cannot be allocated.
+ */
+static int find_neighbors(const matrix_t* points, size_t k, double* dist, size_t* idx,
+                          int num_threads) {
+    double* norms;
+    size_t n, bi;
+
+    n = points->rows;
+    norms = squared_norms(points);
+    if (!norms) return 0;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 1) num_threads(num_threads)
+#endif
+    for (bi = 0; bi < n; bi += KNN_TILE) {
+        double tile[KNN_TILE * KNN_TILE];
+        const double* tile_row;
+        double* row_dist;
+        size_t* row_idx;
+        double value;
+        size_t count[KNN_TILE];
+        size_t bj, i, j, i_end, j_end;
+
+        i_end = bi + KNN_TILE < n ? bi + KNN_TILE : n;
+        for (i = bi; i < i_end; i++) count[i - bi] = 0;
+        for (bj = 0; bj < n; bj += KNN_TILE) {
+            j_end = bj + KNN_TILE < n ? bj + KNN_TILE : n;
+            squared_distance_tile(points, norms, bi, i_end, bj, j_end, tile, KNN_TILE);
+            for (i = bi; i < i_end; i++) {
+                tile_row = tile + (i - bi) * KNN_TILE;
+                row_dist = dist + i * k;
+                row_idx = idx + i * k;
+                for (j = bj; j < j_end; j++) {
+                    if (j == i) continue;
+                    value = tile_row[j - bj];
+                    if (count[i - bi] < k) {
+                        row_dist[count[i - bi]] = value;
+                        row_idx[count[i - bi]] = j;
+                        sift_up(row_dist, row_idx, count[i - bi]);
+                        count[i - bi]++;
+                    } else if (closer(value, j, row_dist[0], row_idx[0])) {
+                        row_dist[0] = value;
+                        row_idx[0] = j;
+                        sift_down(row_dist, row_idx, k, 0);
+                    }
+                }
+            }
+        }
+    }
+    free(norms);
+    (void)num_threads;
+    return 1;
+}
+
+/* qsort comparator ordering edges by column */
+static int compare_edges(const void* a, const void* b) {
+    size_t col_a, col_b;
+
+    col_a = ((const knn_edge_t*)a)->col;
+    col_b = ((const knn_edge_t*)b)->col;
+    return (col_a > col_b) - (col_a < col_b);
+}
+
+/*
+ * Build the symmetric CSR matrix holding every directed neighbor edge in
+ * both directions; edges found from both ends are stored once
+ * weight holds the similarity of every edge, laid out like idx
+ */
+static csr_matrix_t* symmetrize(size_t n, size_t k, const double* weight, const size_t* idx) {
+    csr_matrix_t* result;
+    knn_edge_t* edges;
+    size_t* fill;
+    size_t i, j, e, row_start, row_end, out, staged;
+
+    staged = 2 * n * k;
+    fill = (size_t*)calloc(n + 1, sizeof(size_t));
+    edges = (knn_edge_t*)malloc((staged > 0 ? staged : 1) * sizeof(knn_edge_t));
+    if (!fill || !edges) {
+        free(fill); free(edges);
+        return NULL;
+    }
+    /* Row offsets of the staging area: every edge lands in two rows */
+    for (i = 0; i < n; i++) {
+        for (e = 0; e < k; e++) {
+            fill[i + 1]++;
+            fill[idx[i * k + e] + 1]++;
+        }
+    }
+    for (i = 0; i < n; i++) {
+        fill[i + 1] += fill[i];
+    }
+    for (i = 0; i < n; i++) {
+        for (e = 0; e < k; e++) {
+            j = idx[i * k + e];
+            edges[fill[i]].col = j;
+            edges[fill[i]].value = weight[i * k + e];
+            fill[i]++;
+            edges[fill[j]].col = i;
+            edges[fill[j]].value = weight[i * k + e];
+            fill[j]++;
+        }
+    }
+    /* fill[i] now points at the end of row i; sort rows and drop duplicates in place */
+    out = 0;
+    row_start = 0;
+    for (i = 0; i < n; i++) {
+        row_end = fill[i];
+        qsort(edges + row_start, row_end - row_start, sizeof(knn_edge_t), compare_edges);
+        fill[i] = out;  /* Becomes the compacted row start */
+        for (e = row_start; e < row_end; e++) {
+            if (e > row_start && edges[e].col == edges[e - 1].col) continue;
+            edges[out++] = edges[e];
+        }
+        row_start = row_end;
+    }
+    fill[n] = out;
+
+    result = csr_create(n, n, out);
+    if (result) {
+        for (i = 0; i <= n; i++) {
+            result->row_ptr[i] = fill[i];
+        }
+        for (e = 0; e < out; e++) {
+            result->col_idx[e] = edges[e].col;
+            result->values[e] = edges[e].value;
+        }
+    }
+    free(fill); free(edges);
+    return result;
+}
+
+/* Calculate the symmetrized kNN similarity matrix */
+csr_matrix_t* knn_sym(const matrix_t* points, size_t neighbors, int num_threads) {
+    csr_matrix_t* result;
+    double* dist;
+    size_t* idx;
+    size_t n, k, total, c;
+
+    num_threads = resolve_num_threads(num_threads);
+    n = points->rows;
+    k = n == 0 ? 0 : (neighbors < n - 1 ? neighbors : n - 1);
+    total = n * k > 0 ? n * k : 1;
+    dist = (double*)malloc(total * sizeof(double));
+    idx = (size_t*)malloc(total * sizeof(size_t));
+    if (!dist || !idx) {
+        free(dist); free(idx);
+        return NULL;
+    }
+    if (!find_neighbors(points, k, dist, idx, num_threads)) {
+        free(dist); free(idx);
+        return NULL;
+    }
+    /* Turn the distances into similarities in place */
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) num_threads(num_threads)
+#endif
+    for (c = 0; c < n * k; c += KNN_EXP_CHUNK) {
+        size_t i, end;
+
+        end = c + KNN_EXP_CHUNK < n * k ? c + KNN_EXP_CHUNK : n * k;
+        for (i = c; i < end; i++) dist[i] *= -0.5;
+        vexp(dist + c, dist + c, end - c);
+    }
+    (void)num_threads;
+    result = symmetrize(n, k, dist, idx);
+    free(dist); free(idx);
+    return result;
+}
+
+/* Calculate the normalized kNN similarity matrix */
+csr_matrix_t* knn_norm(const matrix_t* points, size_t neighbors, int num_threads) {
+    csr_matrix_t* W;
+    double* inv_sqrt_degree;
+    size_t n, i;
+
+    num_threads = resolve_num_threads(num_threads);
+    W = knn_sym(points, neighbors, num_threads);
+    if (!W) return NULL;
+    n = W->rows;
+    inv_sqrt_degree = (double*)malloc((n ? n : 1) * sizeof(double));
+    if (!inv_sqrt_degree) {
+        csr_free(W);
+        return NULL;
+    }
+    /* D^-1/2 from the row sums, each row summed in column order */
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) num_threads(num_threads)
+#endif
+    for (i = 0; i < n; i++) {
+        double sum;
+        size_t e;
+
+        sum = 0.0;
+        for (e = W->row_ptr[i]; e < W->row_ptr[i + 1]; e++) {
+            sum += W->values[e];
+        }
+        inv_sqrt_degree[i] = 1.0 / sqrt(sum);
+    }
+    /* Scale every stored entry by D^-1/2[i] * D^-1/2[j] */
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) num_threads(num_threads)
+#endif
+    for (i = 0; i < n; i++) {
+        size_t e;
+
+        for (e = W->row_ptr[i]; e < W->row_ptr[i + 1]; e++) {
+            W->values[e] *= inv_sqrt_degree[i] * inv_sqrt_degree[W->col_idx[e]];
+        }
+    }
+    free(inv_sqrt_degree);
+    return W;
+}
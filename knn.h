@@ -0,0 +1,35 @@
+#ifndef KNN_H
+#define KNN_H
+
+#include <stddef.h>
+#include "matrix.h"
+#include "sparse.h"
+
+/* Sparse k-nearest-neighbor similarity graphs */
+
+/* Neighbors per point used when the caller does not choose */
+#define DEFAULT_NEIGHBORS 10
+
+/*
+ * Calculate the symmetrized k-nearest-neighbor similarity matrix
+ * Entry (i, j) holds exp(-||xi - xj||^2 / 2) when j is among the nearest
+ * neighbors of i or i among those of j, and is absent otherwise. Stored
+ * values are bit-identical to the same entries of sym. The search is
+ * exact brute force: O(n^2 * d) time, O(n * neighbors) memory
+ * @param points: Input data points as n x d matrix
+ * @param neighbors: Neighbors kept per point (capped at n - 1)
+ * @param num_threads: Threads to use, or 0 for SYMNMF_NUM_THREADS / OpenMP default
+ * @return: n x n sparse similarity matrix, or NULL if error occurs
+ */
+csr_matrix_t* knn_sym(const matrix_t* points, size_t neighbors, int num_threads);
+
+/*
+ * Calculate the normalized k-nearest-neighbor similarity matrix D^-1/2 A D^-1/2
+ * @param points: Input data points as n x d matrix
+ * @param neighbors: Neighbors kept per point (capped at n - 1)
+ * @param num_threads: Threads to use, or 0 for SYMNMF_NUM_THREADS / OpenMP default
+ * @return: n x n sparse normalized similarity matrix, or NULL if error occurs
+ */
+csr_matrix_t* knn_norm(const matrix_t* points, size_t neighbors, int num_threads);
+
+#endif /* KNN_H */
\ No newline at end of file
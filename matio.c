@@ -0,0 +1,510 @@
+/*
+ * Matrix files
+ * Text goes through the parallel CSV reader. Binary files are mapped into
+ * memory (or read whole where mmap is unavailable), their header is
+ * checked against the file size, and the payload is copied into an owned
+ * matrix by parallel rows, swapping bytes or transposing only when the
+ * file's byte order or element order differs from the host's.
+ */
+
+#if defined(__unix__) || defined(__APPLE__)
+#define _POSIX_C_SOURCE 200112L
+#define MATIO_MMAP
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef MATIO_MMAP
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+#include "matio.h"
+#include "parallel.h"
+
+#define NPY_MAGIC "\223NUMPY"
+#define NPY_MAGIC_LENGTH 6
+#define NPY_ALIGNMENT 64  /* The header is padded so the payload starts at a multiple of this */
+#define NPY_MAX_HEADER 128  /* Enough for the dictionary of any 2-D float matrix */
+
+/*
+ * File contents, mapped or read
+ * @field bytes: First byte of the file
+ * @field size: File size in bytes
+ * @field mapped: Whether bytes is a mapping rather than a malloc'd copy
+ */
+typedef struct matio_file_t {
+    const unsigned char* bytes;
+    size_t size;
+    int mapped;
+} matio_file_t;
+
+/*
+ * Location and layout of the elements in a file
+ * @field data: First element
+ * @field rows: Number of rows
+ * @field cols: Number of columns
+ * @field size: Element size, 8 or 4
+ * @field swap: Whether the file's byte order differs from the host's
+ * @field fortran: Whether elements are stored column by column
+ */
+typedef struct matio_payload_t {
+    const unsigned char* data;
+    size_t rows;
+    size_t cols;
+    int size;
+    int swap;
+    int fortran;
+} matio_payload_t;
+
+/* Set the error, if the caller wants it; returns 0 for convenience */
+static int fail(csv_error_t* error, const char* message) {
+    if (error) {
+        error->line = 0;
+        error->message = message;
+    }
+    return 0;
+}
+
+/* Whether the host stores the least significant byte first */
+static int host_is_little(void) {
+    unsigned int probe;
+
+    probe = 1;
+    return *(unsigned char*)&probe == 1;
+}
+
+/* Decode a little-endian unsigned field; returns 0 if it does not fit in size_t */
+static int load_le(const unsigned char* p, int bytes, size_t* value) {
+    int i;
+
+    *value = 0;
+    for (i = bytes - 1; i >= 0; i--) {
+        if (*value > ((size_t)-1 >> 8)) return 0;
+        *value = (*value << 8) | p[i];
+    }
+    return 1;
+}
+
+/* Encode an unsigned field little-endian */
+static void store_le(unsigned char* p, size_t value, int bytes) {
+    int i;
+
+    for (i = 0; i < bytes; i++) {
+        p[i] = (unsigned char)(value & 0xff);
+        value >>= 8;
+    }
+}
+
+/* Reverse the byte order of count elements of the given size in place */
+static void swap_bytes(unsigned char* p, size_t count, int size) {
+    unsigned char t;
+    size_t e;
+    int b;
+
+    for (e = 0; e < count; e++, p += size) {
+        for (b = 0; b < size / 2; b++) {
+            t = p[b];
+            p[b] = p[size - 1 - b];
+            p[size - 1 - b] = t;
+        }
+    }
+}
+
+/* Map (or read) a whole file */
+static int open_file(const char* filename, matio_file_t* file, csv_error_t* error) {
+    FILE* stream;
+    unsigned char* buffer;
+    long length;
+#ifdef MATIO_MMAP
+    struct stat info;
+    void* mapping;
+    int fd;
+
+    fd = open(filename, O_RDONLY);
+    if (fd < 0) return fail(error, "cannot open file");
+    mapping = MAP_FAILED;
+    if (fstat(fd, &info) == 0 && info.st_size > 0) {
+        mapping = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (mapping != MAP_FAILED) {
+        file->bytes = (const unsigned char*)mapping;
+        file->size = (size_t)info.st_size;
+        file->mapped = 1;
+        return 1;
+    }
+#endif
+    /* Read the file instead */
+    stream = fopen(filename, "rb");
+    if (!stream) return fail(error, "cannot open file");
+    buffer = NULL;
+    if (fseek(stream, 0, SEEK_END) == 0 && (length = ftell(stream)) > 0 && fseek(stream, 0, SEEK_SET) == 0) {
+        buffer = (unsigned char*)malloc((size_t)length);
+        if (buffer && fread(buffer, 1, (size_t)length, stream) != (size_t)length) {
+            free(buffer);
+            buffer = NULL;
+        }
+    }
+    fclose(stream);
+    if (!buffer) return fail(error, "cannot read file");
+    file->bytes = buffer;
+    file->size = (size_t)length;
+    file->mapped = 0;
+    return 1;
+}
+
+/* Release what open_file acquired */
+static void close_file(matio_file_t* file) {
+#ifdef MATIO_MMAP
+    if (file->mapped) {
+        munmap((void*)file->bytes, file->size);
+        return;
+    }
+#endif
+    free((void*)file->bytes);
+}
+
+/* Check that the elements after offset fill the payload; sets payload->data */
+static int locate_payload(const matio_file_t* file, size_t offset, matio_payload_t* payload,
+                          csv_error_t* error) {
+    size_t available;
+
+    if (payload->rows == 0 || payload->cols == 0) return fail(error, "no data");
+    if (offset > file->size) return fail(error, "truncated header");
+    available = (file->size - offset) / (size_t)payload->size;
+    if (payload->rows > available / payload->cols) return fail(error, "truncated data");
+    payload->data = file->bytes + offset;
+    return 1;
+}
+
+/* Parse the raw binary header */
+static int parse_raw(const matio_file_t* file, matio_payload_t* payload, csv_error_t* error) {
+    const unsigned char* p;
+    size_t size, reserved;
+
+    p = file->bytes;
+    if (file->size < MATIO_RAW_HEADER || memcmp(p, MATIO_RAW_MAGIC, 8) != 0) {
+        return fail(error, "not a raw matrix file");
+    }
+    load_le(p + 8, 4, &size);
+    load_le(p + 12, 4, &reserved);
+    if ((size != 8 && size != 4) || reserved != 0) return fail(error, "unsupported element type");
+    if (!load_le(p + 16, 8, &payload->rows) || !load_le(p + 24, 8, &payload->cols)) {
+        return fail(error, "matrix too large");
+    }
+    payload->size = (int)size;
+    payload->swap = !host_is_little();
+    payload->fortran = 0;
+    return locate_payload(file, MATIO_RAW_HEADER, payload, error);
+}
+
+/* Value of a key of the .npy header dictionary, or NULL if absent */
+static const char* npy_value(const char* header, const char* key) {
+    const char* p;
+
+    p = strstr(header, key);
+    if (!p) return NULL;
+    p += strlen(key);
+    while (*p == ' ') p++;
+    if (*p++ != ':') return NULL;
+    while (*p == ' ') p++;
+    return p;
+}
+
+/* Parse the .npy shape tuple into rows and cols */
+static int npy_shape(const char* p, matio_payload_t* payload) {
+    size_t dims[3];
+    char* end;
+    int count;
+
+    if (*p++ != '(') return 0;
+    count = 0;
+    for (;;) {
+        while (*p == ' ') p++;
+        if (*p == ')') break;
+        if (*p < '0' || *p > '9' || count == 3) return 0;
+        dims[count++] = (size_t)strtoul(p, &end, 10);
+        p = end;
+        while (*p == ' ') p++;
+        if (*p == ',') p++;
+    }
+    if (count == 1) {
+        dims[1] = 1;
+    } else if (count != 2) {
+        return 0;
+    }
+    payload->rows = dims[0];
+    payload->cols = dims[1];
+    return 1;
+}
+
+/* Parse the .npy header */
+static int parse_npy(const matio_file_t* file, matio_payload_t* payload, csv_error_t* error) {
+    const unsigned char* p;
+    const char* value;
+    char* header;
+    size_t length, offset;
+    int ok;
+
+    p = file->bytes;
+    if (file->size < NPY_MAGIC_LENGTH + 4 || memcmp(p, NPY_MAGIC, NPY_MAGIC_LENGTH) != 0) {
+        return fail(error, "not a .npy file");
+    }
+    if (p[6] == 1) {
+        load_le(p + 8, 2, &length);
+        offset = 10;
+    } else if ((p[6] == 2 || p[6] == 3) && file->size >= 12) {
+        load_le(p + 8, 4, &length);
+        offset = 12;
+    } else {
+        return fail(error, "unsupported .npy version");
+    }
+    if (length > file->size - offset) return fail(error, "truncated header");
+    header = (char*)malloc(length + 1);
+    if (!header) return fail(error, "out of memory");
+    memcpy(header, p + offset, length);
+    header[length] = '\0';
+    /* The dictionary is written by NumPy's repr, so a key scan is enough */
+    value = npy_value(header, "'descr'");
+    ok = value && (value[0] == '\'' || value[0] == '"') &&
+         (value[1] == '<' || value[1] == '>' || value[1] == '=') && value[2] == 'f' &&
+         (value[3] == '8' || value[3] == '4') && value[4] == value[0];
+    if (ok) {
+        payload->size = value[3] - '0';
+        payload->swap = value[1] != '=' && (value[1] == '<') != host_is_little();
+        value = npy_value(header, "'fortran_order'");
+        ok = value && (strncmp(value, "True", 4) == 0 || strncmp(value, "False", 5) == 0);
+    }
+    if (ok) {
+        payload->fortran = *value == 'T';
+        value = npy_value(header, "'shape'");
+        ok = value && npy_shape(value, payload);
+    }
+    free(header);
+    if (!ok) return fail(error, "unsupported .npy header");
+    return locate_payload(file, offset + length, payload, error);
+}
+
+/* Element (i, j) of the payload */
+static const unsigned char* payload_at(const matio_payload_t* payload, size_t i, size_t j) {
+    size_t index;
+
+    index = payload->fortran ? j * payload->rows + i : i * payload->cols + j;
+    return payload->data + index * (size_t)payload->size;
+}
+
+/* Element (i, j) of the payload in host order, as a double */
+static double payload_value(const matio_payload_t* payload, size_t i, size_t j) {
+    unsigned char bytes[8];
+    double d;
+    float f;
+
+    memcpy(bytes, payload_at(payload, i, j), (size_t)payload->size);
+    if (payload->swap) swap_bytes(bytes, 1, payload->size);
+    if (payload->size == 8) {
+        memcpy(&d, bytes, sizeof(d));
+        return d;
+    }
+    memcpy(&f, bytes, sizeof(f));
+    return (double)f;
+}
+
+/* Copy row i of the payload into a row of doubles */
+static void copy_row(const matio_payload_t* payload, size_t i, double* row) {
+    size_t j;
+
+    if (payload->size == 8 && !payload->fortran) {
+        memcpy(row, payload_at(payload, i, 0), payload->cols * sizeof(double));
+        if (payload->swap) swap_bytes((unsigned char*)row, payload->cols, 8);
+        return;
+    }
+    for (j = 0; j < payload->cols; j++) {
+        row[j] = payload_value(payload, i, j);
+    }
+}
+
+/* Copy row i of a float32 payload into a row of floats */
+static void copy_frow(const matio_payload_t* payload, size_t i, float* row) {
+    size_t j;
+
+    if (!payload->fortran) {
+        memcpy(row, payload_at(payload, i, 0), payload->cols * sizeof(float));
+        if (payload->swap) swap_bytes((unsigned char*)row, payload->cols, 4);
+        return;
+    }
+    for (j = 0; j < payload->cols; j++) {
+        row[j] = (float)payload_value(payload, i, j);
+    }
+}
+
+/* Read a binary file into an owned matrix */
+static int read_binary(const char* filename, matio_format_t format, int num_threads,
+                       matrix_t** matrix, fmatrix_t** fmatrix, csv_error_t* error) {
+    matio_file_t file;
+    matio_payload_t payload;
+    size_t i;
+    int single, ok;
+
+    if (!open_file(filename, &file, error)) return 0;
+    ok = format == MATIO_NPY ? parse_npy(&file, &payload, error) : parse_raw(&file, &payload, error);
+    if (ok) {
+        single = fmatrix && payload.size == 4;
+        if (single) {
+            *fmatrix = fmatrix_create(payload.rows, payload.cols);
+            ok = *fmatrix != NULL;
+        } else {
+            *matrix = matrix_create(payload.rows, payload.cols);
+            ok = *matrix != NULL;
+        }
+        if (!ok) fail(error, "out of memory");
+    }
+    if (ok) {
+        /* Copying in parallel also spreads the page faults of the mapping */
+        num_threads = resolve_num_threads(num_threads);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) num_threads(num_threads)
+#endif
+        for (i = 0; i < payload.rows; i++) {
+            if (single) {
+                copy_frow(&payload, i, FMATRIX_ROW(*fmatrix, i));
+            } else {
+                copy_row(&payload, i, MATRIX_ROW(*matrix, i));
+            }
+        }
+    }
+    close_file(&file);
+    return ok;
+}
+
+/* Format implied by the file name */
+matio_format_t matio_format_of(const char* filename) {
+    size_t length;
+
+    length = strlen(filename);
+    if (length >= 4 && strcmp(filename + length - 4, ".npy") == 0) return MATIO_NPY;
+    if (length >= 4 && strcmp(filename + length - 4, ".bin") == 0) return MATIO_RAW;
+    return MATIO_TEXT;
+}
+
+/* Format from its name */
+int matio_parse_format(const char* name, matio_format_t* format) {
+    if (strcmp(name, "txt") == 0) {
+        *format = MATIO_TEXT;
+    } else if (strcmp(name, "bin") == 0) {
+        *format = MATIO_RAW;
+    } else if (strcmp(name, "npy") == 0) {
+        *format = MATIO_NPY;
+    } else {
+        return 0;
+    }
+    return 1;
+}
+
+/* Read a matrix file in any format */
+int matio_read(const char* filename, matio_format_t format, int num_threads,
+               matrix_t** matrix, fmatrix_t** fmatrix, csv_error_t* error) {
+    *matrix = NULL;
+    if (fmatrix) *fmatrix = NULL;
+    if (error) {
+        error->line = 0;
+        error->message = NULL;
+    }
+    if (format == MATIO_TEXT) {
+        *matrix = csv_read(filename, num_threads, error);
+        return *matrix != NULL;
+    }
+    return read_binary(filename, format, num_threads, matrix, fmatrix, error);
+}
+
+/* Write the header of a binary file; returns 0 on error */
+static int write_header(FILE* stream, matio_format_t format, size_t rows, size_t cols, int size) {
+    unsigned char raw[MATIO_RAW_HEADER];
+    char header[NPY_MAX_HEADER];
+    size_t length, total;
+
+    if (format == MATIO_RAW) {
+        memcpy(raw, MATIO_RAW_MAGIC, 8);
+        store_le(raw + 8, (size_t)size, 4);
+        store_le(raw + 12, 0, 4);
+        store_le(raw + 16, rows, 8);
+        store_le(raw + 24, cols, 8);
+        return fwrite(raw, 1, sizeof(raw), stream) == sizeof(raw);
+    }
+    /* Version 1.0: magic, version, 2-byte length, then the dictionary padded with spaces and '\n' */
+    memcpy(header, NPY_MAGIC "\001\000", 8);
+    sprintf(header + 10, "{'descr': '<f%d', 'fortran_order': False, 'shape': (%lu, %lu), }",
+            size, (unsigned long)rows, (unsigned long)cols);
+    length = 10 + strlen(header + 10) + 1;
+    total = (length + NPY_ALIGNMENT - 1) / NPY_ALIGNMENT * NPY_ALIGNMENT;
+    memset(header + length - 1, ' ', total - length);
+    header[total - 1] = '\n';
+    store_le((unsigned char*)header + 8, total - 10, 2);
+    return fwrite(header, 1, total, stream) == total;
+}
+
+/* Write exactly one of matrix, fmatrix, diag and packed in a binary format */
+static int write_file(const char* filename, matio_format_t format, const matrix_t* matrix,
+                      const fmatrix_t* fmatrix, const diag_matrix_t* diag, const packed_matrix_t* packed) {
+    FILE* stream;
+    unsigned char* scratch;
+    const void* row;
+    size_t rows, cols, i, bytes;
+    int size, swap, ok;
+
+    if (format == MATIO_TEXT) return 0;
+    rows = matrix ? matrix->rows : fmatrix ? fmatrix->rows : diag ? diag->n : packed->n;
+    cols = matrix ? matrix->cols : fmatrix ? fmatrix->cols : diag ? diag->n : packed->n;
+    size = fmatrix ? (int)sizeof(float) : (int)sizeof(double);
+    bytes = cols * (size_t)size;
+    /* Payloads are little-endian; a big-endian host swaps a copy of each row */
+    swap = !host_is_little();
+    scratch = swap || diag || packed ? (unsigned char*)calloc(cols ? cols : 1, (size_t)size) : NULL;
+    if ((swap || diag || packed) && !scratch) return 0;
+    stream = fopen(filename, "wb");
+    ok = stream && write_header(stream, format, rows, cols, size);
+    for (i = 0; ok && i < rows; i++) {
+        if (diag) {
+            /* One zero row, with the diagonal entry set while it is written */
+            memcpy(scratch + i * sizeof(double), &diag->values[i], sizeof(double));
+            if (swap) swap_bytes(scratch + i * sizeof(double), 1, size);
+            ok = fwrite(scratch, 1, bytes, stream) == bytes;
+            memset(scratch + i * sizeof(double), 0, sizeof(double));
+            continue;
+        }
+        if (packed) {
+            /* Both triangles of the row, gathered from its tiles */
+            packed_get_row(packed, i, (double*)scratch);
+            row = scratch;
+        } else {
+            row = matrix ? (const void*)MATRIX_ROW(matrix, i) : (const void*)FMATRIX_ROW(fmatrix, i);
+        }
+        if (swap) {
+            if (row != scratch) memcpy(scratch, row, bytes);
+            swap_bytes(scratch, cols, size);
+            row = scratch;
+        }
+        ok = fwrite(row, 1, bytes, stream) == bytes;
+    }
+    if (stream && fclose(stream) != 0) ok = 0;
+    free(scratch);
+    return ok;
+}
+
+/* Write a matrix in a binary format */
+int matio_write(const char* filename, matio_format_t format,
+                const matrix_t* matrix, const fmatrix_t* fmatrix) {
+    return write_file(filename, format, matrix, matrix ? NULL : fmatrix, NULL, NULL);
+}
+
+/* Write a diagonal matrix densely in a binary format */
+int matio_write_diagonal(const char* filename, matio_format_t format, const diag_matrix_t* matrix) {
+    return write_file(filename, format, NULL, NULL, matrix, NULL);
+}
+
+/* Write a packed symmetric matrix densely in a binary format */
+int matio_write_packed(const char* filename, matio_format_t format, const packed_matrix_t* matrix) {
+    return write_file(filename, format, NULL, NULL, NULL, matrix);
+}
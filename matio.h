@@ -0,0 +1,92 @@
+#ifndef MATIO_H
+#define MATIO_H
+
+#include "matrix.h"
+#include "csv.h"
+#include "sparse.h"
+
+/* Matrix files: comma-separated text, raw binary and NumPy .npy */
+
+/*
+ * Raw binary layout, all fields little-endian:
+ *   bytes  0-7   magic "SYMNMF\0\1"
+ *   bytes  8-11  element size, 8 for float64 or 4 for float32
+ *   bytes 12-15  zero
+ *   bytes 16-23  rows
+ *   bytes 24-31  cols
+ *   bytes 32-    rows * cols elements, row-major
+ */
+#define MATIO_RAW_MAGIC "SYMNMF\0\1"
+#define MATIO_RAW_HEADER 32
+
+/* File format of a matrix */
+typedef enum matio_format_t {
+    MATIO_TEXT,  /* One row per line, values separated by commas */
+    MATIO_RAW,   /* The raw binary layout above */
+    MATIO_NPY    /* NumPy .npy, version 1.0 written, 1.0 to 3.0 read */
+} matio_format_t;
+
+/*
+ * Format implied by a file name: .npy, .bin, anything else is text
+ * @param filename: Name of the file
+ * @return: The format
+ */
+matio_format_t matio_format_of(const char* filename);
+
+/*
+ * Format named "txt", "bin" or "npy"
+ * @param name: The name
+ * @param format: Receives the format
+ * @return: 1 on success, 0 if the name is unknown
+ */
+int matio_parse_format(const char* name, matio_format_t* format);
+
+/*
+ * Read a matrix file
+ * Binary files are memory-mapped where the platform allows and copied
+ * into an owned matrix in parallel; .npy files may be little- or
+ * big-endian, C or Fortran order, 1-D (read as one column) or 2-D.
+ * @param filename: Name of the file
+ * @param format: Its format
+ * @param num_threads: Threads to use, or 0 for SYMNMF_NUM_THREADS / OpenMP default
+ * @param matrix: Receives the matrix in double precision
+ * @param fmatrix: If not NULL, receives float32 payloads unconverted
+ *                 (and *matrix is set to NULL)
+ * @param error: Receives the reason of a failure, may be NULL
+ * @return: 1 on success, 0 if error occurs
+ */
+int matio_read(const char* filename, matio_format_t format, int num_threads,
+               matrix_t** matrix, fmatrix_t** fmatrix, csv_error_t* error);
+
+/*
+ * Write a matrix in a binary format
+ * @param filename: Name of the file, replaced if it exists
+ * @param format: MATIO_RAW or MATIO_NPY
+ * @param matrix: Double-precision matrix, or NULL
+ * @param fmatrix: Single-precision matrix, used if matrix is NULL
+ * @return: 1 on success, 0 if error occurs (including MATIO_TEXT)
+ */
+int matio_write(const char* filename, matio_format_t format,
+                const matrix_t* matrix, const fmatrix_t* fmatrix);
+
+/*
+ * Write a diagonal matrix in a binary format as a dense n x n float64
+ * matrix, one row at a time, without storing its zeros
+ * @param filename: Name of the file, replaced if it exists
+ * @param format: MATIO_RAW or MATIO_NPY
+ * @param matrix: Diagonal matrix
+ * @return: 1 on success, 0 if error occurs (including MATIO_TEXT)
+ */
+int matio_write_diagonal(const char* filename, matio_format_t format, const diag_matrix_t* matrix);
+
+/*
+ * Write a packed symmetric matrix in a binary format as a dense n x n
+ * float64 matrix, one gathered row at a time
+ * @param filename: Name of the file, replaced if it exists
+ * @param format: MATIO_RAW or MATIO_NPY
+ * @param matrix: Packed symmetric matrix
+ * @return: 1 on success, 0 if error occurs (including MATIO_TEXT)
+ */
+int matio_write_packed(const char* filename, matio_format_t format, const packed_matrix_t* matrix);
+
+#endif /* MATIO_H */
@@ -0,0 +1,143 @@
+/*
+ * Dense matrix storage
+ * Each matrix header and its element buffer share one allocation; the
+ * buffer is aligned to MATRIX_ALIGNMENT and every row is padded so that
+ * all row starts are aligned as well.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "matrix.h"
+
+/*
+ * Allocate a header of header_size bytes followed by a zeroed, aligned
+ * rows x cols buffer of elem_size-byte elements; rows are padded to the
+ * alignment. Stores the row stride and the buffer start.
+ */
+static void* create_aligned(size_t header_size, size_t rows, size_t cols, size_t elem_size,
+                            size_t* stride, void** data) {
+    size_t per_alignment, elems, bytes;
+    char* block;
+    char* base;
+
+    per_alignment = MATRIX_ALIGNMENT / elem_size;
+    *stride = (cols + per_alignment - 1) / per_alignment * per_alignment;
+    if (*stride < cols) return NULL;  /* Overflow */
+    if (*stride != 0 && rows > ((size_t)-1 / elem_size) / *stride) return NULL;
+    elems = rows * *stride;
+    bytes = elems * elem_size;
+    if (bytes > (size_t)-1 - header_size - MATRIX_ALIGNMENT) return NULL;
+
+    block = (char*)malloc(header_size + MATRIX_ALIGNMENT + bytes);
+    if (!block) return NULL;
+    /* Place data at the first aligned address after the header */
+    base = block + header_size;
+    base += (MATRIX_ALIGNMENT - (size_t)base % MATRIX_ALIGNMENT) % MATRIX_ALIGNMENT;
+    memset(base, 0, bytes);
+    *data = base;
+    return block;
+}
+
+/* Allocate a zero-initialized, aligned matrix in one allocation */
+matrix_t* matrix_create(size_t rows, size_t cols) {
+    matrix_t* m;
+    size_t stride;
+    void* data;
+
+    m = (matrix_t*)create_aligned(sizeof(matrix_t), rows, cols, sizeof(double), &stride, &data);
+    if (!m) return NULL;
+    m->data = (double*)data;
+    m->rows = rows;
+    m->cols = cols;
+    m->stride = stride;
+    return m;
+}
+
+/* Free a matrix and its buffer */
+void matrix_free(matrix_t* m) {
+    free(m);
+}
+
+/* Describe a range of rows of m as a matrix of its own */
+matrix_t matrix_rows(const matrix_t* m, size_t first, size_t last) {
+    matrix_t view;
+
+    view.data = m->data + first * m->stride;
+    view.rows = last - first;
+    view.cols = m->cols;
+    view.stride = m->stride;
+    return view;
+}
+
+/* Allocate a zero-initialized, aligned single-precision matrix */
+fmatrix_t* fmatrix_create(size_t rows, size_t cols) {
+    fmatrix_t* m;
+    size_t stride;
+    void* data;
+
+    m = (fmatrix_t*)create_aligned(sizeof(fmatrix_t), rows, cols, sizeof(float), &stride, &data);
+    if (!m) return NULL;
+    m->data = (float*)data;
+    m->rows = rows;
+    m->cols = cols;
+    m->stride = stride;
+    return m;
+}
+
+/* Free a single-precision matrix and its buffer */
+void fmatrix_free(fmatrix_t* m) {
+    free(m);
+}
+
+/* Describe a range of rows of m as a matrix of its own */
+fmatrix_t fmatrix_rows(const fmatrix_t* m, size_t first, size_t last) {
+    fmatrix_t view;
+
+    view.data = m->data + first * m->stride;
+    view.rows = last - first;
+    view.cols = m->cols;
+    view.stride = m->stride;
+    return view;
+}
+
+/* Allocate a zero packed symmetric matrix in one allocation */
+packed_matrix_t* packed_create(size_t n) {
+    packed_matrix_t* m;
+    size_t blocks, tiles, stride;
+    void* data;
+
+    blocks = (n + PACKED_BLOCK - 1) / PACKED_BLOCK;
+    tiles = blocks * (blocks + 1) / 2;
+    if (tiles > (size_t)-1 / PACKED_BLOCK) return NULL;
+    /* The tiles are laid out as the rows of a tiles * PACKED_BLOCK x PACKED_BLOCK matrix */
+    m = (packed_matrix_t*)create_aligned(sizeof(packed_matrix_t), tiles * PACKED_BLOCK, PACKED_BLOCK,
+                                         sizeof(double), &stride, &data);
+    if (!m) return NULL;
+    m->data = (double*)data;
+    m->n = n;
+    m->blocks = blocks;
+    return m;
+}
+
+/* Free a packed matrix and its buffer */
+void packed_free(packed_matrix_t* m) {
+    free(m);
+}
+
+/* Gather row i from the column of tiles left of the diagonal and the row of tiles right of it */
+void packed_get_row(const packed_matrix_t* m, size_t i, double* row) {
+    const double* tile;
+    size_t I, J, r, j, width;
+
+    I = i / PACKED_BLOCK;
+    r = i % PACKED_BLOCK;
+    for (J = 0; J < m->blocks; J++) {
+        width = m->n - J * PACKED_BLOCK < PACKED_BLOCK ? m->n - J * PACKED_BLOCK : PACKED_BLOCK;
+        if (J < I) {
+            tile = PACKED_TILE(m, J, I) + r;
+            for (j = 0; j < width; j++) row[J * PACKED_BLOCK + j] = tile[j * PACKED_BLOCK];
+        } else {
+            memcpy(row + J * PACKED_BLOCK, PACKED_TILE(m, I, J) + r * PACKED_BLOCK, width * sizeof(double));
+        }
+    }
+}
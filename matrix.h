@@ -0,0 +1,147 @@
+#ifndef MATRIX_H
+#define MATRIX_H
+
+#include <stddef.h>
+
+/* Dense matrix storage */
+
+/* Alignment in bytes of every matrix buffer and of every row start */
+#define MATRIX_ALIGNMENT 64
+
+/*
+ * Dense row-major matrix backed by a single contiguous buffer
+ * Kernels do not rely on the alignment or the padding, so a matrix may
+ * also be a read-only view of memory it does not own (e.g. a NumPy array)
+ * @field data: First element, aligned to MATRIX_ALIGNMENT bytes for owned matrices
+ * @field rows: Number of rows
+ * @field cols: Number of columns
+ * @field stride: Distance in elements between the starts of consecutive rows
+ */
+typedef struct matrix_t {
+    double* data;
+    size_t rows;
+    size_t cols;
+    size_t stride;
+} matrix_t;
+
+/* Pointer to the first element of row i */
+#define MATRIX_ROW(m, i) ((m)->data + (size_t)(i) * (m)->stride)
+
+/* Element (i, j) as an lvalue */
+#define MATRIX_AT(m, i, j) (MATRIX_ROW(m, i)[j])
+
+/*
+ * Allocate a zero-initialized matrix in one allocation
+ * @param rows: Number of rows
+ * @param cols: Number of columns
+ * @return: New matrix, or NULL if error occurs
+ */
+matrix_t* matrix_create(size_t rows, size_t cols);
+
+/*
+ * Free a matrix created by matrix_create (NULL is ignored)
+ * @param m: The matrix to free
+ */
+void matrix_free(matrix_t* m);
+
+/*
+ * View rows [first, last) of a matrix without copying
+ * The view shares the buffer of m and must not be passed to matrix_free
+ * @param m: Source matrix
+ * @param first: First row of the view
+ * @param last: One past the last row of the view
+ * @return: Matrix header describing the rows
+ */
+matrix_t matrix_rows(const matrix_t* m, size_t first, size_t last);
+
+/*
+ * Single-precision counterpart of matrix_t, used to halve the size of W
+ * Same layout rules: one allocation, aligned buffer, rows padded to
+ * MATRIX_ALIGNMENT bytes
+ * @field data: First element, aligned to MATRIX_ALIGNMENT bytes
+ * @field rows: Number of rows
+ * @field cols: Number of columns
+ * @field stride: Distance in elements between the starts of consecutive rows
+ */
+typedef struct fmatrix_t {
+    float* data;
+    size_t rows;
+    size_t cols;
+    size_t stride;
+} fmatrix_t;
+
+/* Pointer to the first element of row i */
+#define FMATRIX_ROW(m, i) ((m)->data + (size_t)(i) * (m)->stride)
+
+/* Element (i, j) as an lvalue */
+#define FMATRIX_AT(m, i, j) (FMATRIX_ROW(m, i)[j])
+
+/*
+ * Allocate a zero-initialized single-precision matrix in one allocation
+ * @param rows: Number of rows
+ * @param cols: Number of columns
+ * @return: New matrix, or NULL if error occurs
+ */
+fmatrix_t* fmatrix_create(size_t rows, size_t cols);
+
+/*
+ * Free a matrix created by fmatrix_create (NULL is ignored)
+ * @param m: The matrix to free
+ */
+void fmatrix_free(fmatrix_t* m);
+
+/*
+ * View rows [first, last) of a single-precision matrix without copying
+ * @param m: Source matrix
+ * @param first: First row of the view
+ * @param last: One past the last row of the view
+ * @return: Matrix header describing the rows
+ */
+fmatrix_t fmatrix_rows(const fmatrix_t* m, size_t first, size_t last);
+
+/* Side of the square tiles of packed_matrix_t */
+#define PACKED_BLOCK 64
+
+/*
+ * Symmetric n x n matrix storing only the tiles on or above the diagonal
+ * The matrix is cut into PACKED_BLOCK x PACKED_BLOCK tiles; tile (I, J)
+ * with I <= J is row-major and contiguous, tiles follow each other tile
+ * row by tile row, and (i, j) below the diagonal is read as (j, i).
+ * Diagonal tiles are stored whole and edge tiles are zero padded, so the
+ * buffer holds about n^2 / 2 + n * PACKED_BLOCK / 2 entries.
+ * @field data: First element of tile (0, 0), aligned to MATRIX_ALIGNMENT bytes
+ * @field n: Number of rows and columns
+ * @field blocks: Number of tile rows, ceil(n / PACKED_BLOCK)
+ */
+typedef struct packed_matrix_t {
+    double* data;
+    size_t n;
+    size_t blocks;
+} packed_matrix_t;
+
+/* Pointer to the first element of tile (I, J), for I <= J */
+#define PACKED_TILE(m, I, J) ((m)->data + ((size_t)(I) * (m)->blocks - (size_t)(I) * ((size_t)(I) - 1) / 2 \
+                                           + (size_t)(J) - (size_t)(I)) * PACKED_BLOCK * PACKED_BLOCK)
+
+/*
+ * Allocate a zero symmetric packed matrix in one allocation
+ * @param n: Number of rows and columns
+ * @return: New matrix, or NULL if error occurs
+ */
+packed_matrix_t* packed_create(size_t n);
+
+/*
+ * Free a matrix created by packed_create (NULL is ignored)
+ * @param m: The matrix to free
+ */
+void packed_free(packed_matrix_t* m);
+
+/*
+ * Copy row i of a packed matrix, both triangles, into a dense vector
+ * @param m: Packed matrix (n x n)
+ * @param i: Row to copy
+ * @param row: Receives the row (n entries)
+ */
+void packed_get_row(const packed_matrix_t* m, size_t i, double* row);
+
+#endif /* MATRIX_H */
@@ -0,0 +1,38 @@
+/*
+ * Thread count selection for the OpenMP kernels
+ * Builds without OpenMP compile the pragmas away and always run on one thread.
+ */
+
+#include <stdlib.h>
+#include "parallel.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/* Resolve an explicit, environment or default thread count */
+int resolve_num_threads(int requested) {
+#ifdef _OPENMP
+    const char* env;
+    char* end;
+    long value;
+
+    if (requested > 0) return requested;
+    env = getenv(NUM_THREADS_ENV);
+    if (env) {
+        value = strtol(env, &end, 10);
+        if (end != env && *end == '\0' && value > 0 && value <= 4096) return (int)value;
+    }
+    return omp_get_max_threads();
+#else
+    (void)requested;
+    return 1;
+#endif
+}
+/* Team-relative index of the calling thread */
+int current_thread(void) {
+#ifdef _OPENMP
+    return omp_get_thread_num();
+#else
+    return 0;
+#endif
+}
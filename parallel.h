@@ -0,0 +1,24 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+/* Thread count selection for the OpenMP kernels */
+
+/* Environment variable consulted when no explicit thread count is given */
+#define NUM_THREADS_ENV "SYMNMF_NUM_THREADS"
+
+/*
+ * Resolve the number of threads a kernel should use
+ * @param requested: Explicit thread count, or 0 (or less) for the default
+ * @return: requested if positive, else the value of SYMNMF_NUM_THREADS if it
+ *          is a positive integer, else the OpenMP default; always 1 when
+ *          built without OpenMP
+ */
+int resolve_num_threads(int requested);
+
+/*
+ * Index of the calling thread within its OpenMP team
+ * @return: 0 to team size - 1; 0 outside a parallel region or without OpenMP
+ */
+int current_thread(void);
+
+#endif /* PARALLEL_H */
\ No newline at end of file
@@ -0,0 +1,58 @@
+/*
+ * MT19937 (Matsumoto and Nishimura, 1998)
+ * Seeding and the 53-bit double conversion follow NumPy's RandomState,
+ * so a seed gives the same sequence as numpy.random.seed in Python.
+ */
+
+#include "rng.h"
+
+#define MT_SHIFT 397
+#define MATRIX_A 0x9908b0dfUL
+#define UPPER_MASK 0x80000000UL
+#define LOWER_MASK 0x7fffffffUL
+#define WORD_MASK 0xffffffffUL
+
+/* Knuth's linear initialization of the state from one 32-bit seed */
+void rng_seed(rng_t* rng, unsigned long seed) {
+    int i;
+
+    rng->mt[0] = seed & WORD_MASK;
+    for (i = 1; i < RNG_STATE_SIZE; i++) {
+        rng->mt[i] = (1812433253UL * (rng->mt[i - 1] ^ (rng->mt[i - 1] >> 30)) + (unsigned long)i) & WORD_MASK;
+    }
+    rng->index = RNG_STATE_SIZE;
+}
+
+/* Regenerate all state words */
+static void twist(rng_t* rng) {
+    unsigned long y;
+    int i;
+
+    for (i = 0; i < RNG_STATE_SIZE; i++) {
+        y = (rng->mt[i] & UPPER_MASK) | (rng->mt[(i + 1) % RNG_STATE_SIZE] & LOWER_MASK);
+        rng->mt[i] = rng->mt[(i + MT_SHIFT) % RNG_STATE_SIZE] ^ (y >> 1) ^ ((y & 1UL) ? MATRIX_A : 0UL);
+    }
+    rng->index = 0;
+}
+
+/* Next tempered 32-bit word */
+static unsigned long next_word(rng_t* rng) {
+    unsigned long y;
+
+    if (rng->index >= RNG_STATE_SIZE) twist(rng);
+    y = rng->mt[rng->index++];
+    y ^= y >> 11;
+    y ^= (y << 7) & 0x9d2c5680UL;
+    y ^= (y << 15) & 0xefc60000UL;
+    y ^= y >> 18;
+    return y & WORD_MASK;
+}
+
+/* 27 + 26 random bits scaled to [0, 1) */
+double rng_uniform(rng_t* rng) {
+    unsigned long a, b;
+
+    a = next_word(rng) >> 5;
+    b = next_word(rng) >> 6;
+    return ((double)a * 67108864.0 + (double)b) / 9007199254740992.0;
+}
@@ -0,0 +1,32 @@
+#ifndef RNG_H
+#define RNG_H
+
+/* Mersenne Twister random numbers matching NumPy's legacy generator */
+
+#define RNG_STATE_SIZE 624
+
+/*
+ * MT19937 state; every caller owns its own, so no state is shared
+ * @field mt: The 624 state words (32 significant bits each)
+ * @field index: Next word of mt to temper, RNG_STATE_SIZE when exhausted
+ */
+typedef struct rng_t {
+    unsigned long mt[RNG_STATE_SIZE];
+    int index;
+} rng_t;
+
+/*
+ * Seed the generator the way numpy.random.seed(seed) does for an integer seed
+ * @param rng: Generator to initialize
+ * @param seed: Seed, of which the low 32 bits are used
+ */
+void rng_seed(rng_t* rng, unsigned long seed);
+
+/*
+ * Draw from [0, 1) with 53 random bits, equal to numpy.random.random_sample()
+ * @param rng: Seeded generator
+ * @return: The sample
+ */
+double rng_uniform(rng_t* rng);
+
+#endif /* RNG_H */
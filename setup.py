@@ -1,7 +1,13 @@
 from setuptools import setup, Extension
 
 symnmf_module = Extension('symnmf',
-                         sources=['symnmfmodule.c', 'symnmf.c'])
+                         sources=['symnmfmodule.c', 'symnmf.c', 'matrix.c', 'gemm.c',
+                                  'parallel.c', 'distance.c', 'sparse.c', 'affinity.c',
+                                  'knn.c', 'implicit.c', 'vexp.c', 'cpu.c', 'kernels.c', 'rng.c',
+                                  'csv.c', 'matio.c',
+                                  'textout.c'],
+                         extra_compile_args=['-fopenmp', '-ffp-contract=off'],
+                         extra_link_args=['-fopenmp'])
 
 setup(name='symnmf',
       version='1.0',
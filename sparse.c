@@ -0,0 +1,104 @@
+/*
+ * Compressed sparse row (CSR) and diagonal matrix storage
+ * Like matrix_t, the header and the arrays share one allocation.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "sparse.h"
+
+/* Allocate header, row offsets, column indices and values in one block */
+csr_matrix_t* csr_create(size_t rows, size_t cols, size_t nnz) {
+    csr_matrix_t* m;
+    size_t index_bytes, value_bytes;
+    char* base;
+
+    if (rows + 1 == 0 || rows + 1 + nnz < nnz) return NULL;  /* Overflow */
+    if (rows + 1 + nnz > ((size_t)-1 - sizeof(csr_matrix_t)) / (sizeof(size_t) + sizeof(double))) {
+        return NULL;
+    }
+    index_bytes = (rows + 1 + nnz) * sizeof(size_t);
+    value_bytes = nnz * sizeof(double);
+    /* size_t and double share alignment on every supported platform */
+    m = (csr_matrix_t*)malloc(sizeof(csr_matrix_t) + index_bytes + value_bytes);
+    if (!m) return NULL;
+    base = (char*)(m + 1);
+    m->row_ptr = (size_t*)base;
+    m->col_idx = m->row_ptr + rows + 1;
+    m->values = (double*)(base + index_bytes);
+    m->rows = rows;
+    m->cols = cols;
+    m->nnz = nnz;
+    memset(m->row_ptr, 0, (rows + 1) * sizeof(size_t));
+    return m;
+}
+
+/* Free a CSR matrix and its arrays */
+void csr_free(csr_matrix_t* m) {
+    free(m);
+}
+
+/* Describe a range of rows of m; row_ptr keeps absolute offsets */
+csr_matrix_t csr_rows(const csr_matrix_t* m, size_t first, size_t last) {
+    csr_matrix_t view;
+
+    view.row_ptr = m->row_ptr + first;
+    view.col_idx = m->col_idx;
+    view.values = m->values;
+    view.rows = last - first;
+    view.cols = m->cols;
+    view.nnz = m->row_ptr[last] - m->row_ptr[first];
+    return view;
+}
+
+/* C = A * B, gathering one row of B per stored entry of A */
+void csr_multiply_into(const csr_matrix_t* A, const matrix_t* B, matrix_t* C) {
+    const double* b_row;
+    double* c_row;
+    double value;
+    size_t i, j, e;
+
+    for (i = 0; i < A->rows; i++) {
+        c_row = MATRIX_ROW(C, i);
+        for (j = 0; j < B->cols; j++) {
+            c_row[j] = 0.0;
+        }
+        for (e = A->row_ptr[i]; e < A->row_ptr[i + 1]; e++) {
+            value = A->values[e];
+            b_row = MATRIX_ROW(B, A->col_idx[e]);
+            for (j = 0; j < B->cols; j++) {
+                c_row[j] += value * b_row[j];
+            }
+        }
+    }
+}
+
+/* Allocate header and diagonal in one block */
+diag_matrix_t* diag_create(size_t n) {
+    diag_matrix_t* m;
+
+    if (n > ((size_t)-1 - sizeof(diag_matrix_t)) / sizeof(double)) return NULL;  /* Overflow */
+    m = (diag_matrix_t*)calloc(1, sizeof(diag_matrix_t) + n * sizeof(double));
+    if (!m) return NULL;
+    m->values = (double*)(m + 1);
+    m->n = n;
+    return m;
+}
+
+/* Free a diagonal matrix and its entries */
+void diag_free(diag_matrix_t* m) {
+    free(m);
+}
+
+/* Dense copy of a diagonal matrix */
+matrix_t* diag_to_dense(const diag_matrix_t* m) {
+    matrix_t* dense;
+    size_t i;
+
+    dense = matrix_create(m->n, m->n);  /* Off-diagonal entries start at zero */
+    if (!dense) return NULL;
+    for (i = 0; i < m->n; i++) {
+        MATRIX_AT(dense, i, i) = m->values[i];
+    }
+    return dense;
+}
@@ -0,0 +1,93 @@
+#ifndef SPARSE_H
+#define SPARSE_H
+
+#include <stddef.h>
+#include "matrix.h"
+
+/* Sparse matrix storage: compressed sparse row (CSR) and diagonal */
+
+/*
+ * Sparse matrix in CSR form
+ * The entries of row i are col_idx[row_ptr[i] .. row_ptr[i+1]) and the
+ * matching values, with column indices strictly increasing within a row
+ * @field row_ptr: Offsets of the row starts (rows + 1 entries)
+ * @field col_idx: Column index of every stored entry (nnz entries)
+ * @field values: Value of every stored entry (nnz entries)
+ * @field rows: Number of rows
+ * @field cols: Number of columns
+ * @field nnz: Number of stored entries
+ */
+typedef struct csr_matrix_t {
+    size_t* row_ptr;
+    size_t* col_idx;
+    double* values;
+    size_t rows;
+    size_t cols;
+    size_t nnz;
+} csr_matrix_t;
+
+/*
+ * Allocate a CSR matrix with room for nnz entries in one allocation
+ * row_ptr is zeroed; col_idx and values are left for the caller to fill
+ * @param rows: Number of rows
+ * @param cols: Number of columns
+ * @param nnz: Number of stored entries
+ * @return: New matrix, or NULL if error occurs
+ */
+csr_matrix_t* csr_create(size_t rows, size_t cols, size_t nnz);
+
+/*
+ * Free a matrix created by csr_create (NULL is ignored)
+ * @param m: The matrix to free
+ */
+void csr_free(csr_matrix_t* m);
+
+/*
+ * View rows [first, last) of a CSR matrix without copying
+ * The view shares the arrays of m and must not be passed to csr_free
+ * @param m: Source matrix
+ * @param first: First row of the view
+ * @param last: One past the last row of the view
+ * @return: Matrix header describing the rows
+ */
+csr_matrix_t csr_rows(const csr_matrix_t* m, size_t first, size_t last);
+
+/*
+ * Sparse-times-dense product into a preallocated result: C = A * B
+ * @param A: Sparse matrix (n x m)
+ * @param B: Dense matrix (m x p)
+ * @param C: Dense result (n x p), overwritten
+ */
+void csr_multiply_into(const csr_matrix_t* A, const matrix_t* B, matrix_t* C);
+
+/*
+ * Diagonal n x n matrix, storing only the diagonal
+ * @field values: Diagonal entries (n entries)
+ * @field n: Number of rows and columns
+ */
+typedef struct diag_matrix_t {
+    double* values;
+    size_t n;
+} diag_matrix_t;
+
+/*
+ * Allocate a zero diagonal matrix in one allocation
+ * @param n: Number of rows and columns
+ * @return: New matrix, or NULL if error occurs
+ */
+diag_matrix_t* diag_create(size_t n);
+
+/*
+ * Free a matrix created by diag_create (NULL is ignored)
+ * @param m: The matrix to free
+ */
+void diag_free(diag_matrix_t* m);
+
+/*
+ * Expand a diagonal matrix into a dense one
+ * @param m: Diagonal matrix (n x n)
+ * @return: New dense matrix (n x n), or NULL if error occurs
+ */
+matrix_t* diag_to_dense(const diag_matrix_t* m);
+
+#endif /* SPARSE_H */
@@ -8,383 +8,1116 @@
 #include <string.h>
 #include <stdio.h>
 #include "symnmf.h"
+#include "parallel.h"
+#include "distance.h"
+#include "vexp.h"
+#include "kernels.h"
+#include "rng.h"
+#include "csv.h"
+#include "matio.h"
+#include "textout.h"
 
 #define MAX_ITER 300
 #define EPSILON 1e-4
-#define MAX_LINE_LENGTH 1024
+#define SYM_TILE PACKED_BLOCK  /* Side of the square tiles of the similarity matrix (64) */
+#define UPDATE_CHUNK 256  /* Rows of H per work item in update_H */
+#define H_SEED 1234  /* Seed of the initial H, as in symnmf.py */
+#define MIXED_SWITCH 1e-3  /* Change below which symnmf_mixed moves to double W */
+#define MIXED_TOLERANCE 1e-6  /* Max |H_mixed - H| against symnmf, checked by tests/regress.sh */
 
 
 /* Matrix multiplication: multiply matrices A(n x m) and B(m x p) */
-double** matrix_multiply(double** A, double** B, int n, int m, int p) {
-    double** C = NULL;
-    int i, j, k;
-    
-    C = (double**)malloc(n * sizeof(double*));
+matrix_t* matrix_multiply(const matrix_t* A, const matrix_t* B) {
+    matrix_t* C;
+
+    C = matrix_create(A->rows, B->cols);
     if (!C) return NULL;
-    
-    for (i = 0; i < n; i++) {
-        C[i] = (double*)calloc(p, sizeof(double)); /* Initialize to zero */
-        if (!C[i]) {
-            free_c_array(C, i);
-            return NULL;
-        }
-        for (j = 0; j < p; j++) {
-            C[i][j] = 0.0;  /* Explicit initialization */
-            for (k = 0; k < m; k++) {
-                C[i][j] += A[i][k] * B[k][j];
-            }
-        }
-    }
+    matrix_multiply_into(A, B, C);
     return C;
 }
 
 /* Create transpose of matrix A */
-double** transpose_matrix(double** A, int n, int m) {
-    double** result;
-    int i, j;
-    
-    result = (double**)malloc(m * sizeof(double*));
+matrix_t* transpose_matrix(const matrix_t* A) {
+    matrix_t* result;
+    size_t i, j;
+
+    result = matrix_create(A->cols, A->rows);
     if (!result) return NULL;
-    
-    for (i = 0; i < m; i++) {
-        result[i] = (double*)malloc(n * sizeof(double));
-        if (!result[i]) {
-            free_c_array(result, i);
-            return NULL;
-        }
-        for (j = 0; j < n; j++) {
-            result[i][j] = A[j][i];
+
+    for (i = 0; i < A->cols; i++) {
+        for (j = 0; j < A->rows; j++) {
+            MATRIX_AT(result, i, j) = MATRIX_AT(A, j, i);
         }
     }
     return result;
 }
 
 /* Compute Frobenius norm of difference between matrices A and B */
-double calculate_frobenius_norm(double** A, double** B, int n, int k) {
-    double sum, diff;
-    int i, j;
-    
-    sum = 0.0;
-    for (i = 0; i < n; i++) {
-        for (j = 0; j < k; j++) {
-            diff = A[i][j] - B[i][j];
-            sum += diff * diff;
-        }
-    }
-    return sum;
+double calculate_frobenius_norm(const matrix_t* A, const matrix_t* B) {
+    return kernels()->squared_difference(A, B);
 }
 
 /* Copy contents of matrix src to dest */
-void copy_matrix(double** dest, double** src, int n, int k) {
-    int i, j;
-    
-    for (i = 0; i < n; i++) {
-        for (j = 0; j < k; j++) {
-            dest[i][j] = src[i][j];
+void copy_matrix(matrix_t* dest, const matrix_t* src) {
+    size_t i;
+
+    if (dest->stride == src->stride) {
+        memcpy(dest->data, src->data, src->rows * src->stride * sizeof(double));
+        return;
+    }
+    for (i = 0; i < src->rows; i++) {
+        memcpy(MATRIX_ROW(dest, i), MATRIX_ROW(src, i), src->cols * sizeof(double));
+    }
+}
+
+/* Compute Gram matrix A^T A */
+matrix_t* gram_matrix(const matrix_t* A) {
+    matrix_t* G;
+
+    G = matrix_create(A->cols, A->cols);
+    if (!G) return NULL;
+    gram_matrix_into(A, G);
+    return G;
+}
+
+/* Allocate all per-run temporaries of symnmf for an n x k factor */
+symnmf_workspace_t* symnmf_workspace_create(size_t n, size_t k) {
+    symnmf_workspace_t* ws;
+
+    ws = (symnmf_workspace_t*)calloc(1, sizeof(symnmf_workspace_t));
+    if (!ws) return NULL;
+    ws->n = n;
+    ws->k = k;
+    ws->num_chunks = (n + UPDATE_CHUNK - 1) / UPDATE_CHUNK;
+    ws->WH = matrix_create(n, k);
+    ws->HHtH = matrix_create(n, k);
+    ws->H_cur = matrix_create(n, k);
+    ws->H_next = matrix_create(n, k);
+    ws->gram_partials = matrix_create(ws->num_chunks * k, k);
+    ws->delta_partials = (double*)malloc((ws->num_chunks ? ws->num_chunks : 1) * sizeof(double));
+    if (!ws->WH || !ws->HHtH || !ws->H_cur || !ws->H_next ||
+        !ws->gram_partials || !ws->delta_partials) {
+        symnmf_workspace_free(ws);
+        return NULL;
+    }
+    if (k > SKINNY_COLS) {
+        /* Wide H goes through the packed kernel: pack each right-hand side once per product */
+        ws->H_packed = gemm_prepacked_create(n, k);
+        ws->H_next_packed = gemm_prepacked_create(n, k);
+        if (!ws->H_packed || !ws->H_next_packed) {
+            symnmf_workspace_free(ws);
+            return NULL;
         }
     }
+    if (!symnmf_workspace_reserve(ws, resolve_num_threads(0))) {
+        symnmf_workspace_free(ws);
+        return NULL;
+    }
+    return ws;
+}
+
+/* Reallocate the per-thread slots for num_threads threads; old contents are not kept */
+int symnmf_workspace_reserve(symnmf_workspace_t* ws, int num_threads) {
+    size_t slots;
+
+    slots = num_threads > 0 ? (size_t)num_threads : 1;
+    if (slots <= ws->num_slots) return 1;
+    matrix_free(ws->HtH);
+    gemm_prepacked_free(ws->HtH_packed);
+    free(ws->a_scratch);
+    ws->HtH_packed = NULL;
+    ws->a_scratch = NULL;
+    ws->num_slots = 0;
+    ws->HtH = matrix_create(slots * ws->k, ws->k);
+    if (!ws->HtH) return 0;
+    if (ws->H_packed) {
+        ws->HtH_packed = gemm_prepacked_create_array(slots, ws->k, ws->k);
+        ws->a_scratch = (double*)malloc(slots * GEMM_A_SCRATCH * sizeof(double));
+        if (!ws->HtH_packed || !ws->a_scratch) return 0;
+    }
+    ws->num_slots = slots;
+    return 1;
 }
 
-/* Update H matrix according to symNMF update rule */
-int update_H(double** W, double** H, int n, int k) {
-    double** WH = NULL;     /* W*H */
-    double** Ht = NULL;     /* H^T */
-    double** HHt = NULL;    /* H*H^T */
-    double** HHtH = NULL;   /* (H*H^T)*H */
+/* Free a workspace and all matrices it holds */
+void symnmf_workspace_free(symnmf_workspace_t* ws) {
+    if (ws) {
+        matrix_free(ws->WH);
+        matrix_free(ws->HtH);
+        matrix_free(ws->HHtH);
+        matrix_free(ws->H_cur);
+        matrix_free(ws->H_next);
+        matrix_free(ws->gram_partials);
+        free(ws->delta_partials);
+        gemm_prepacked_free(ws->H_packed);
+        gemm_prepacked_free(ws->H_next_packed);
+        gemm_prepacked_free(ws->HtH_packed);
+        free(ws->a_scratch);
+        free(ws);
+    }
+}
+
+/*
+ * One update of H into H_next
+ * Work is split into fixed UPDATE_CHUNK row blocks and every reduction is
+ * summed in block order, so the result does not depend on the thread count.
+ * When H is wide, H_packed must hold H packed for the W*H product; each
+ * block of H_next is packed into H_next_packed as soon as it is written,
+ * so the next step finds it packed. The worksharing directives are
+ * orphaned: called inside a parallel region they split the work across
+ * the team, called outside they run serially.
+ * A step costs two barriers, one after each phase. The k x k H^T*H and the
+ * change norm are tiny, so every thread sums them itself, in the same
+ * order, into its own slot instead of waiting on a single thread.
+ */
+static double update_step(const affinity_t* W, const matrix_t* H, const gemm_prepacked_t* H_packed,
+                          matrix_t* H_next, gemm_prepacked_t* H_next_packed, symnmf_workspace_t* ws) {
     const double beta = 0.5;
-    int i, j;
-    WH = matrix_multiply(W, H, n, n, k);
-    if (!WH) {
-        return 0;
+    double* scratch;
+    gemm_prepacked_t* HtH_packed;
+    matrix_t HtH;
+    double delta;
+    size_t n, k, slot, b, c, i, j;
+
+    n = H->rows;
+    k = H->cols;
+    slot = (size_t)current_thread();
+    scratch = ws->a_scratch ? ws->a_scratch + slot * GEMM_A_SCRATCH : NULL;
+    HtH_packed = ws->HtH_packed ? ws->HtH_packed + slot : NULL;
+    HtH = matrix_rows(ws->HtH, slot * k, (slot + 1) * k);
+    /* Phase 1: W*H and per-block Gram contributions H_c^T H_c */
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic, 1) nowait
+#endif
+    for (c = 0; c < ws->num_chunks; c++) {
+        size_t first, last;
+        matrix_t H_c, WH_c, G_c;
+
+        first = c * UPDATE_CHUNK;
+        last = first + UPDATE_CHUNK < n ? first + UPDATE_CHUNK : n;
+        H_c = matrix_rows(H, first, last);
+        WH_c = matrix_rows(ws->WH, first, last);
+        G_c = matrix_rows(ws->gram_partials, c * k, (c + 1) * k);
+        if (H_packed) {
+            affinity_multiply_rows_prepacked(W, H, H_packed, scratch, first, last, &WH_c);   /* W*H */
+        } else {
+            affinity_multiply_rows(W, H, first, last, &WH_c);   /* W*H */
+        }
+        gram_matrix_into(&H_c, &G_c);
     }
-    Ht = transpose_matrix(H, n, k);
-    if (!Ht) {
-        free_c_array(WH, n);
-        return 0;
+#ifdef _OPENMP
+#pragma omp barrier
+#endif
+    /* H^T*H (k x k) from the block contributions, into this thread's slot */
+    for (i = 0; i < k; i++) {
+        for (j = 0; j < k; j++) {
+            MATRIX_AT(&HtH, i, j) = 0.0;
+            for (b = 0; b < ws->num_chunks; b++) {
+                MATRIX_AT(&HtH, i, j) += MATRIX_AT(ws->gram_partials, b * k + i, j);
+            }
+        }
     }
-    HHt = matrix_multiply(H, Ht, n, k, n);
-    if (!HHt) {
-        free_c_array(WH, n);
-        free_c_array(Ht, k);
-        return 0;
+    if (HtH_packed) gemm_prepack_rows(&HtH, 0, k, HtH_packed);
+    /* Phase 2: H*(H^T*H), the multiplicative update and the change norm */
+#ifdef _OPENMP
+#pragma omp for schedule(static) nowait
+#endif
+    for (c = 0; c < ws->num_chunks; c++) {
+        size_t first, last;
+        matrix_t H_c, WH_c, HHtH_c, next_c;
+
+        first = c * UPDATE_CHUNK;
+        last = first + UPDATE_CHUNK < n ? first + UPDATE_CHUNK : n;
+        H_c = matrix_rows(H, first, last);
+        WH_c = matrix_rows(ws->WH, first, last);
+        HHtH_c = matrix_rows(ws->HHtH, first, last);
+        next_c = matrix_rows(H_next, first, last);
+        /* H*(H^T*H), equal to (H*H^T)*H */
+        if (HtH_packed) {
+            matrix_multiply_prepacked_into(&H_c, HtH_packed, scratch, &HHtH_c);
+        } else {
+            matrix_multiply_into(&H_c, &HtH, &HHtH_c);
+        }
+        /* Update each element of H */
+        ws->delta_partials[c] = kernels()->multiplicative_update(&H_c, &WH_c, &HHtH_c, &next_c, beta);
+        if (H_next_packed) gemm_prepack_rows(H_next, first, last, H_next_packed);
     }
-    HHtH = matrix_multiply(HHt, H, n, n, k);
-    if (!HHtH) {
-        free_c_array(WH, n);
-        free_c_array(Ht, k);
-        free_c_array(HHt, n);
-        return 0;
+#ifdef _OPENMP
+#pragma omp barrier
+#endif
+    delta = 0.0;
+    for (b = 0; b < ws->num_chunks; b++) {
+        delta += ws->delta_partials[b];
     }
-    /* Update each element of H */
-    for (i = 0; i < n; i++) {
-        for (j = 0; j < k; j++) {
-            H[i][j] *= (1 - beta + beta * (WH[i][j]/HHtH[i][j]));
+    /* The next step's first barrier orders these reads before delta_partials is rewritten */
+    return delta;
+}
+
+/*
+ * Compute H_next from H according to symNMF update rule
+ * A wide H is packed into ws->H_packed first; see update_step
+ */
+double update_H(const affinity_t* W, const matrix_t* H, matrix_t* H_next, symnmf_workspace_t* ws) {
+    double delta;
+    size_t n, c;
+
+    n = H->rows;
+    if (ws->H_packed) {
+#ifdef _OPENMP
+#pragma omp for schedule(static)
+#endif
+        for (c = 0; c < ws->num_chunks; c++) {
+            gemm_prepack_rows(H, c * UPDATE_CHUNK, c * UPDATE_CHUNK + UPDATE_CHUNK < n ? c * UPDATE_CHUNK + UPDATE_CHUNK : n,
+                              ws->H_packed);
         }
     }
-    /* Free temporary matrices */
-    free_c_array(WH, n); free_c_array(Ht, k); free_c_array(HHt, n); free_c_array(HHtH, n);
-    return 1;  /* Success */ 
+    delta = update_step(W, H, ws->H_packed, H_next, ws->H_next_packed, ws);
+    if (current_thread() == 0) ws->delta = delta;
+    return delta;
 }
 
-/* Free a 2D array and handle NULL pointers safely */
-void free_c_array(double** array, int n) {
-    int i;
-    
-    if (array) {
-        for (i = 0; i < n; i++) {
-            if (array[i]) {
-                free(array[i]);
+/*
+ * Fill the similarity matrix of points
+ * Visits only tiles on or above the diagonal; each pair is computed once
+ * and mirrored, and both the row tile and its transposed counterpart stay
+ * in cache while a tile pair is processed. Tile rows are handed out
+ * dynamically (the first ones carry the most tiles) and every element is
+ * written by exactly one thread, so the result does not depend on the
+ * thread count. Exactly one of similarity, similarity32 and packed is
+ * non-NULL and receives the result; the single-precision one stores each
+ * value rounded and the packed one stores each tile once, as its tiles
+ * are those of the loop. Returns 0 if the point norms cannot be allocated.
+ */
+static int fill_similarity(const matrix_t* points, matrix_t* similarity, fmatrix_t* similarity32,
+                           packed_matrix_t* packed, int num_threads) {
+    double* norms;
+    size_t n, bi;
+
+    n = points->rows;
+    norms = squared_norms(points);
+    if (!norms) return 0;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 1) num_threads(num_threads)
+#endif
+    for (bi = 0; bi < n; bi += SYM_TILE) {
+        double tile[SYM_TILE * SYM_TILE];
+        double* row;
+        double* out;
+        double value;
+        size_t bj, i, j, i_end, j_end;
+
+        i_end = bi + SYM_TILE < n ? bi + SYM_TILE : n;
+        for (bj = bi; bj < n; bj += SYM_TILE) {
+            j_end = bj + SYM_TILE < n ? bj + SYM_TILE : n;
+            squared_distance_tile(points, norms, bi, i_end, bj, j_end, tile, SYM_TILE);
+            /* Exponentiate the whole tile row by row */
+            for (i = bi; i < i_end; i++) {
+                row = tile + (i - bi) * SYM_TILE;
+                for (j = 0; j < j_end - bj; j++) row[j] *= -0.5;
+                vexp(row, row, j_end - bj);
+            }
+            for (i = bi; i < i_end; i++) {
+                for (j = (bj > i + 1 ? bj : i + 1); j < j_end; j++) {
+                    value = tile[(i - bi) * SYM_TILE + (j - bj)];
+                    if (similarity) {
+                        MATRIX_AT(similarity, i, j) = value;
+                        MATRIX_AT(similarity, j, i) = value;
+                    } else if (similarity32) {
+                        FMATRIX_AT(similarity32, i, j) = (float)value;
+                        FMATRIX_AT(similarity32, j, i) = (float)value;
+                    } else {
+                        /* Diagonal tiles are stored whole, the others only above it */
+                        out = PACKED_TILE(packed, bi / SYM_TILE, bj / SYM_TILE);
+                        out[(i - bi) * SYM_TILE + (j - bj)] = value;
+                        if (bi == bj) out[(j - bj) * SYM_TILE + (i - bi)] = value;
+                    }
+                }
             }
         }
-        free(array);
     }
+    free(norms);
+    (void)num_threads;
+    return 1;
 }
 
-/* Calculate similarity matrix from input points */
-double** sym(double** points, int n, int d) {
-    double** similarity;
-    double sum;
-    double diff;
-    int i, j, k;
-    
-    similarity = (double**)malloc(n * sizeof(double*));
-    if (!similarity) return NULL;
-    
+/*
+ * Sum each row of the similarity matrix into degree
+ * Rows are summed left to right by a single thread each, which keeps the
+ * degrees bitwise reproducible for any thread count
+ */
+static void fill_degrees(const matrix_t* similarity, double* degree, int num_threads) {
+    size_t n, i;
+
+    n = similarity->rows;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) num_threads(num_threads)
+#endif
     for (i = 0; i < n; i++) {
-        similarity[i] = (double*)malloc(n * sizeof(double));
-        if (!similarity[i]) {
-            free_c_array(similarity, i);
-            return NULL;
+        const double* s_row;
+        double sum;
+        size_t j;
+
+        s_row = MATRIX_ROW(similarity, i);
+        sum = 0.0;
+        for (j = 0; j < n; j++) {
+            sum += s_row[j];
         }
+        degree[i] = sum;
+    }
+    (void)num_threads;
+}
+
+/* Row sums of a single-precision similarity matrix, accumulated in double */
+static void fill_degrees_f32(const fmatrix_t* similarity, double* degree, int num_threads) {
+    size_t n, i;
+
+    n = similarity->rows;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) num_threads(num_threads)
+#endif
+    for (i = 0; i < n; i++) {
+        const float* s_row;
+        double sum;
+        size_t j;
+
+        s_row = FMATRIX_ROW(similarity, i);
+        sum = 0.0;
         for (j = 0; j < n; j++) {
-            if (i == j) 
-                similarity[i][j] = 0.0;  /* Diagonal elements are 0 */
-            else {
-                /* Calculate squared Euclidean distance */
-                sum = 0.0;
-                for (k = 0; k < d; k++) {
-                    diff = points[i][k] - points[j][k];
-                    sum += diff * diff;
-                }
-                similarity[i][j] = exp(-sum / 2.0);
+            sum += s_row[j];
+        }
+        degree[i] = sum;
+    }
+    (void)num_threads;
+}
+
+/*
+ * Row sums of a packed similarity matrix
+ * Each row is gathered left to right across its tiles, so the degrees
+ * equal those of fill_degrees bit for bit
+ */
+static void fill_degrees_packed(const packed_matrix_t* similarity, double* degree, int num_threads) {
+    size_t n, i;
+
+    n = similarity->n;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) num_threads(num_threads)
+#endif
+    for (i = 0; i < n; i++) {
+        const double* tile;
+        double sum;
+        size_t I, J, r, j, width;
+
+        I = i / PACKED_BLOCK;
+        r = i % PACKED_BLOCK;
+        sum = 0.0;
+        for (J = 0; J < similarity->blocks; J++) {
+            width = n - J * PACKED_BLOCK < PACKED_BLOCK ? n - J * PACKED_BLOCK : PACKED_BLOCK;
+            if (J < I) {
+                tile = PACKED_TILE(similarity, J, I) + r;
+                for (j = 0; j < width; j++) sum += tile[j * PACKED_BLOCK];
+            } else {
+                tile = PACKED_TILE(similarity, I, J) + r * PACKED_BLOCK;
+                for (j = 0; j < width; j++) sum += tile[j];
             }
         }
+        degree[i] = sum;
     }
-    return similarity;
+    (void)num_threads;
 }
 
-/* Calculate diagonal degree matrix using similarity matrix */
-double** ddg(double** points, int n, int d) {
-    double** similarity;
-    double** degree;
-    int i, j;
-    
-    similarity = sym(points, n, d);
+/* Calculate similarity matrix from input points */
+matrix_t* sym(const matrix_t* points, int num_threads) {
+    matrix_t* similarity;
+
+    similarity = matrix_create(points->rows, points->rows);  /* Diagonal elements stay 0 */
     if (!similarity) return NULL;
-    
-    degree = (double**)malloc(n * sizeof(double*));
-    if (!degree) {
-        free_c_array(similarity, n);
+    if (!fill_similarity(points, similarity, NULL, NULL, resolve_num_threads(num_threads))) {
+        matrix_free(similarity);
+        return NULL;
+    }
+    return similarity;
+}
+
+/*
+ * Calculate the degrees as a diagonal matrix
+ * Similarities are summed tile by tile as they are computed, so nothing
+ * of size n x n is allocated
+ */
+diag_matrix_t* ddg_diagonal(const matrix_t* points, int num_threads) {
+    diag_matrix_t* degree;
+
+    degree = diag_create(points->rows);
+    if (!degree) return NULL;
+    if (!implicit_degrees(points, degree->values, num_threads)) {
+        diag_free(degree);
         return NULL;
     }
-    
+    return degree;
+}
+
+/* Calculate diagonal degree matrix, expanded to dense storage */
+matrix_t* ddg(const matrix_t* points, int num_threads) {
+    diag_matrix_t* degree;
+    matrix_t* dense;
+
+    degree = ddg_diagonal(points, num_threads);
+    if (!degree) return NULL;
+    dense = diag_to_dense(degree);
+    diag_free(degree);
+    return dense;
+}
+
+/*
+ * Calculate normalized similarity matrix
+ * The similarity matrix is built in the output buffer and then scaled in
+ * place by the precomputed D^-1/2 vector, so peak memory is a single
+ * n x n matrix
+ */
+matrix_t* norm(const matrix_t* points, int num_threads) {
+    matrix_t* normalized;
+    double* inv_sqrt_degree;
+    size_t n, i;
+    num_threads = resolve_num_threads(num_threads);
+    n = points->rows;
+    normalized = matrix_create(n, n);
+    inv_sqrt_degree = (double*)malloc((n ? n : 1) * sizeof(double));
+    if (!normalized || !inv_sqrt_degree) {
+        matrix_free(normalized); free(inv_sqrt_degree);
+        return NULL;
+    }
+    /* Similarities and degree values */
+    if (!fill_similarity(points, normalized, NULL, NULL, num_threads)) {
+        matrix_free(normalized); free(inv_sqrt_degree);
+        return NULL;
+    }
+    fill_degrees(normalized, inv_sqrt_degree, num_threads);
+    /* D^-1/2, overwriting the degrees */
     for (i = 0; i < n; i++) {
-        degree[i] = (double*)calloc(n, sizeof(double));
-        if (!degree[i]) {
-            free_c_array(similarity, n);
-            free_c_array(degree, i);
-            return NULL;
-        }
-        /* Sum row i to get degree */
+        inv_sqrt_degree[i] = 1.0 / sqrt(inv_sqrt_degree[i]);
+    }
+    /* Normalize in place: W[i][j] = A[i][j] * D^-1/2[i] * D^-1/2[j] */
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) num_threads(num_threads)
+#endif
+    for (i = 0; i < n; i++) {
+        double* n_row;
+        double scale_i;
+        size_t j;
+
+        n_row = MATRIX_ROW(normalized, i);
+        scale_i = inv_sqrt_degree[i];
         for (j = 0; j < n; j++) {
-            degree[i][i] += similarity[i][j];
+            n_row[j] *= scale_i * inv_sqrt_degree[j];
         }
     }
-    free_c_array(similarity, n);
-    return degree;
+    free(inv_sqrt_degree);
+    return normalized;
 }
 
-/* Calculate normalized similarity matrix */
-double** norm(double** points, int n, int d) {
-    double** similarity;
-    double* degree_diag;
-    double** normalized;
-    int i, j;
-    similarity = sym(points, n, d);
+/* Calculate similarity matrix from input points in packed storage */
+packed_matrix_t* sym_packed(const matrix_t* points, int num_threads) {
+    packed_matrix_t* similarity;
+
+    similarity = packed_create(points->rows);
     if (!similarity) return NULL;
-    /* Calculate diagonal degree values */
-    degree_diag = (double*)calloc(n, sizeof(double));
-    if (!degree_diag) {
-        free_c_array(similarity, n);
+    if (!fill_similarity(points, NULL, NULL, similarity, resolve_num_threads(num_threads))) {
+        packed_free(similarity);
         return NULL;
     }
+    return similarity;
+}
+
+/*
+ * Calculate normalized similarity matrix in packed storage
+ * Same steps as norm, tile by tile; every stored entry is scaled by the
+ * same product as its dense counterpart, so the entries are equal bit for bit
+ */
+packed_matrix_t* norm_packed(const matrix_t* points, int num_threads) {
+    packed_matrix_t* normalized;
+    double* inv_sqrt_degree;
+    size_t n, i, bi;
+    num_threads = resolve_num_threads(num_threads);
+    n = points->rows;
+    normalized = packed_create(n);
+    inv_sqrt_degree = (double*)malloc((n ? n : 1) * sizeof(double));
+    if (!normalized || !inv_sqrt_degree) {
+        packed_free(normalized); free(inv_sqrt_degree);
+        return NULL;
+    }
+    if (!fill_similarity(points, NULL, NULL, normalized, num_threads)) {
+        packed_free(normalized); free(inv_sqrt_degree);
+        return NULL;
+    }
+    fill_degrees_packed(normalized, inv_sqrt_degree, num_threads);
     for (i = 0; i < n; i++) {
-        for (j = 0; j < n; j++) {
-            degree_diag[i] += similarity[i][j];
+        inv_sqrt_degree[i] = 1.0 / sqrt(inv_sqrt_degree[i]);
+    }
+    /* Scale tile row by tile row; padding stays 0 */
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 1) num_threads(num_threads)
+#endif
+    for (bi = 0; bi < n; bi += PACKED_BLOCK) {
+        double* row;
+        double scale_i;
+        size_t bj, r, j, r_end, j_end;
+
+        r_end = bi + PACKED_BLOCK < n ? bi + PACKED_BLOCK : n;
+        for (bj = bi; bj < n; bj += PACKED_BLOCK) {
+            j_end = bj + PACKED_BLOCK < n ? bj + PACKED_BLOCK : n;
+            for (r = bi; r < r_end; r++) {
+                row = PACKED_TILE(normalized, bi / PACKED_BLOCK, bj / PACKED_BLOCK) + (r - bi) * PACKED_BLOCK;
+                scale_i = inv_sqrt_degree[r];
+                for (j = bj; j < j_end; j++) {
+                    row[j - bj] *= scale_i * inv_sqrt_degree[j];
+                }
+            }
         }
     }
-    /* Create normalized matrix */
-    normalized = (double**)malloc(n * sizeof(double*));
-    if (!normalized) {
-        free(degree_diag);
-        free_c_array(similarity, n);
+    free(inv_sqrt_degree);
+    return normalized;
+}
+
+/* Calculate single-precision similarity matrix from input points */
+fmatrix_t* sym_f32(const matrix_t* points, int num_threads) {
+    fmatrix_t* similarity;
+
+    similarity = fmatrix_create(points->rows, points->rows);
+    if (!similarity) return NULL;
+    if (!fill_similarity(points, NULL, similarity, NULL, resolve_num_threads(num_threads))) {
+        fmatrix_free(similarity);
         return NULL;
     }
+    return similarity;
+}
+
+/*
+ * Calculate single-precision normalized similarity matrix
+ * Same steps as norm; degrees come from the stored (rounded) similarities
+ * and each scaled entry is computed in double before it is rounded again
+ */
+fmatrix_t* norm_f32(const matrix_t* points, int num_threads) {
+    fmatrix_t* normalized;
+    double* inv_sqrt_degree;
+    size_t n, i;
+    num_threads = resolve_num_threads(num_threads);
+    n = points->rows;
+    normalized = fmatrix_create(n, n);
+    inv_sqrt_degree = (double*)malloc((n ? n : 1) * sizeof(double));
+    if (!normalized || !inv_sqrt_degree) {
+        fmatrix_free(normalized); free(inv_sqrt_degree);
+        return NULL;
+    }
+    if (!fill_similarity(points, NULL, normalized, NULL, num_threads)) {
+        fmatrix_free(normalized); free(inv_sqrt_degree);
+        return NULL;
+    }
+    fill_degrees_f32(normalized, inv_sqrt_degree, num_threads);
     for (i = 0; i < n; i++) {
-        normalized[i] = (double*)malloc(n * sizeof(double));
-        if (!normalized[i]) {
-            free(degree_diag);
-            free_c_array(similarity, n);
-            free_c_array(normalized, i);
-            return NULL;
-        }
-        /* Normalize using degree values */
+        inv_sqrt_degree[i] = 1.0 / sqrt(inv_sqrt_degree[i]);
+    }
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) num_threads(num_threads)
+#endif
+    for (i = 0; i < n; i++) {
+        float* n_row;
+        double scale_i;
+        size_t j;
+
+        n_row = FMATRIX_ROW(normalized, i);
+        scale_i = inv_sqrt_degree[i];
         for (j = 0; j < n; j++) {
-            normalized[i][j] = similarity[i][j] / sqrt(degree_diag[i] * degree_diag[j]);
+            n_row[j] = (float)(n_row[j] * (scale_i * inv_sqrt_degree[j]));
         }
     }
-    free(degree_diag); free_c_array(similarity, n);
+    free(inv_sqrt_degree);
     return normalized;
 }
 
-/* Perform symNMF algorithm */
-double** symnmf(double** W, double** H, int n, int k) {
-    double** H_prev = NULL; 
-    double** result = NULL;
-    int i, iter;
-    /* Allocate memory for matrices */
-    H_prev = (double**)malloc(n * sizeof(double*));
-    if (!H_prev) { return NULL;}
-    result = (double**)malloc(n * sizeof(double*));
-    if (!result) {
-        free_c_array(H_prev, n); return NULL;
-    }
-    /* Allocate memory for each row */
-    for (i = 0; i < n; i++) {
-        H_prev[i] = (double*)malloc(k * sizeof(double));
-        if (!H_prev[i]) {
-            free_c_array(H_prev, i); free_c_array(result, i);
-            return NULL;
+/*
+ * Iterate from ws->H_cur until the change drops below tolerance
+ * One thread team lives for the whole call and each iteration costs two
+ * barriers, one after the W*H/Gram phase and one after the update phase.
+ * The last iterate is left in ws->H_cur.
+ * @return: Number of iterations performed, or -1 if the per-thread
+ *          slots cannot be allocated (ws->H_cur is then left untouched)
+ */
+static int iterate(const affinity_t* W, symnmf_workspace_t* ws, int max_iter, double tolerance,
+                   int num_threads) {
+    int done;
+
+    done = 0;
+    num_threads = resolve_num_threads(num_threads);
+    if (!symnmf_workspace_reserve(ws, num_threads)) return -1;
+    if (ws->H_packed) gemm_prepack_rows(ws->H_cur, 0, ws->n, ws->H_packed);
+#ifdef _OPENMP
+#pragma omp parallel num_threads(num_threads)
+#endif
+    {
+        matrix_t *cur, *next, *tmp;
+        gemm_prepacked_t *cur_packed, *next_packed, *tmp_packed;
+        double delta;
+        int iter;
+
+        delta = ws->delta;
+        /* Each thread swaps its own copy of the pointers, so a step needs no extra barrier */
+        cur = ws->H_cur;
+        next = ws->H_next;
+        cur_packed = ws->H_packed;
+        next_packed = ws->H_next_packed;
+        for (iter = 0; iter < max_iter; iter++) {
+            delta = update_step(W, cur, cur_packed, next, next_packed, ws);
+            tmp = cur; cur = next; next = tmp;
+            tmp_packed = cur_packed; cur_packed = next_packed; next_packed = tmp_packed;
+            /* Every thread sees the same delta, so all leave the loop together */
+            if (delta < tolerance) {
+                iter++;
+                break;
+            }
         }
-        result[i] = (double*)malloc(k * sizeof(double));
-        if (!result[i]) {
-            free_c_array(H_prev, i+1); free_c_array(result, i);
-            return NULL;
+        if (current_thread() == 0) {
+            ws->H_cur = cur;
+            ws->H_next = next;
+            ws->H_packed = cur_packed;
+            ws->H_next_packed = next_packed;
+            ws->delta = delta;
+            done = iter;
         }
     }
-    /* Initialize result with input H */
-    copy_matrix(result, H, n, k);
-    /* Main iteration loop */
-    for (iter = 0; iter < MAX_ITER; iter++) {
-        copy_matrix(H_prev, result, n, k);
-        if (!update_H(W, result, n, k)) {
-            free_c_array(H_prev, n);
-            free_c_array(result, n);
-            return NULL;
-        }
-        if (calculate_frobenius_norm(result, H_prev, n, k) < EPSILON) {
-            break;
-        }
-    }  
-    free_c_array(H_prev, n);
+    (void)num_threads;
+    return done;
+}
+
+/* Perform symNMF algorithm using a caller-provided workspace */
+matrix_t* symnmf_with_workspace(const affinity_t* W, const matrix_t* H, symnmf_workspace_t* ws,
+                                int num_threads) {
+    matrix_t* result;
+    if (ws->n != H->rows || ws->k != H->cols || W->n != H->rows) return NULL;
+    /* Initialize current iterate with input H; H_cur and H_next swap roles every step */
+    copy_matrix(ws->H_cur, H);
+    if (iterate(W, ws, MAX_ITER, EPSILON, num_threads) < 0) return NULL;
+    result = matrix_create(H->rows, H->cols);
+    if (!result) return NULL;
+    copy_matrix(result, ws->H_cur);
     return result;
 }
 
-/* Read input data from file and convert to matrix form */
-double** read_data_from_file(const char* filename, int* n, int* d) {
-    FILE* file; char line[MAX_LINE_LENGTH]; char* token; double** data; int i, j;
-    /* Open and validate file */
-    file = fopen(filename, "r");
-    if (!file) return NULL;
-    /* Count dimensions */
-    *n = 0;
-    *d = 0;
-    while (fgets(line, MAX_LINE_LENGTH, file)) {
-        (*n)++;
-        if (*d == 0) {
-            token = strtok(line, ",");
-            while (token) {
-                (*d)++;
-                token = strtok(NULL, ",");
-            }
-        }
+/* Perform symNMF algorithm on any supported storage of W */
+matrix_t* symnmf_affinity(const affinity_t* W, const matrix_t* H, int num_threads) {
+    symnmf_workspace_t* ws;
+    matrix_t* result;
+    ws = symnmf_workspace_create(H->rows, H->cols);
+    if (!ws) return NULL;
+    result = symnmf_with_workspace(W, H, ws, num_threads);
+    symnmf_workspace_free(ws);
+    return result;
+}
+
+/* Perform symNMF algorithm */
+matrix_t* symnmf(const matrix_t* W, const matrix_t* H, int num_threads) {
+    affinity_t affinity;
+    affinity = affinity_dense(W);
+    return symnmf_affinity(&affinity, H, num_threads);
+}
+
+/* Perform symNMF algorithm on a single-precision W */
+matrix_t* symnmf_f32(const fmatrix_t* W, const matrix_t* H, int num_threads) {
+    affinity_t affinity;
+    affinity = affinity_dense_f32(W);
+    return symnmf_affinity(&affinity, H, num_threads);
+}
+
+/*
+ * Perform symNMF algorithm with single-precision W until MIXED_SWITCH,
+ * then with double W up to EPSILON
+ * The iteration budget MAX_ITER is shared by both phases. Both stop on the
+ * same EPSILON test, so the result agrees with symnmf to MIXED_TOLERANCE
+ * rather than bit for bit. The float copy of W is converted by the thread
+ * team and freed before the double phase, so peak memory is 1.5x W.
+ */
+matrix_t* symnmf_mixed(const matrix_t* W, const matrix_t* H, int num_threads) {
+    symnmf_workspace_t* ws;
+    fmatrix_t* W32;
+    affinity_t affinity;
+    matrix_t* result;
+    size_t n, i;
+    int done;
+
+    n = W->rows;
+    if (W->cols != n || H->rows != n) return NULL;
+    W32 = fmatrix_create(n, n);
+    ws = symnmf_workspace_create(H->rows, H->cols);
+    result = matrix_create(H->rows, H->cols);
+    if (!W32 || !ws || !result) {
+        fmatrix_free(W32);
+        symnmf_workspace_free(ws);
+        matrix_free(result);
+        return NULL;
     }
-    /* Reset to file start */
-    rewind(file);
-    /* Allocate and read data */
-    data = (double**)malloc(*n * sizeof(double*));
-    for (i = 0; i < *n; i++) {
-        data[i] = (double*)malloc(*d * sizeof(double));
-        if (!data[i]) {
-            free_c_array(data, i); fclose(file);
-            return NULL;
-        }
-        if (fgets(line, MAX_LINE_LENGTH, file) == NULL) {
-            free_c_array(data, i + 1); fclose(file);
-            return NULL;
-        }
-        token = strtok(line, ",");
-        for (j = 0; j < *d; j++) {
-            data[i][j] = atof(token);
-            token = strtok(NULL, ",");
+    num_threads = resolve_num_threads(num_threads);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) num_threads(num_threads)
+#endif
+    for (i = 0; i < n; i++) {
+        const double* w_row;
+        float* w32_row;
+        size_t j;
+
+        w_row = MATRIX_ROW(W, i);
+        w32_row = FMATRIX_ROW(W32, i);
+        for (j = 0; j < n; j++) w32_row[j] = (float)w_row[j];
+    }
+    copy_matrix(ws->H_cur, H);
+    affinity = affinity_dense_f32(W32);
+    done = iterate(&affinity, ws, MAX_ITER, MIXED_SWITCH, num_threads);
+    fmatrix_free(W32);
+    /* Polish in double; at least one step so the result is a double iterate */
+    affinity = affinity_dense(W);
+    if (done < 0 || iterate(&affinity, ws, done < MAX_ITER ? MAX_ITER - done : 1, EPSILON, num_threads) < 0) {
+        symnmf_workspace_free(ws);
+        matrix_free(result);
+        return NULL;
+    }
+    copy_matrix(result, ws->H_cur);
+    symnmf_workspace_free(ws);
+    return result;
+}
+
+/* Perform symNMF algorithm on a sparse W */
+matrix_t* symnmf_sparse(const csr_matrix_t* W, const matrix_t* H, int num_threads) {
+    affinity_t affinity;
+    affinity = affinity_csr(W);
+    return symnmf_affinity(&affinity, H, num_threads);
+}
+
+/* Perform symNMF algorithm on a packed W */
+matrix_t* symnmf_packed(const packed_matrix_t* W, const matrix_t* H, int num_threads) {
+    affinity_t affinity;
+    affinity = affinity_packed(W);
+    return symnmf_affinity(&affinity, H, num_threads);
+}
+
+/* Perform symNMF algorithm without ever storing W */
+matrix_t* symnmf_matrix_free(const matrix_t* points, const matrix_t* H, int num_threads) {
+    implicit_affinity_t* W;
+    affinity_t affinity;
+    matrix_t* result;
+    W = implicit_affinity_create(points, num_threads);
+    if (!W) return NULL;
+    affinity = affinity_implicit(W);
+    result = symnmf_affinity(&affinity, H, num_threads);
+    implicit_affinity_free(W);
+    return result;
+}
+
+/* Mean entry of the normalized similarity matrix without storing it */
+double norm_mean(const matrix_t* points, int num_threads) {
+    implicit_affinity_t* W;
+    affinity_t affinity;
+    double mean;
+    W = implicit_affinity_create(points, num_threads);
+    if (!W) return -1.0;
+    affinity = affinity_implicit(W);
+    mean = affinity_mean(&affinity, num_threads);
+    implicit_affinity_free(W);
+    return mean;
+}
+
+/* Draw the initial H row by row from U[0, 2 * sqrt(mean / k)] */
+matrix_t* initialize_h(double mean, size_t n, size_t k) {
+    matrix_t* H;
+    rng_t rng;
+    double upper;
+    size_t i, j;
+
+    if (k == 0 || mean < 0.0) return NULL;
+    H = matrix_create(n, k);
+    if (!H) return NULL;
+    upper = 2 * sqrt(mean / (double)k);
+    rng_seed(&rng, H_SEED);
+    for (i = 0; i < n; i++) {
+        for (j = 0; j < k; j++) {
+            MATRIX_AT(H, i, j) = upper * rng_uniform(&rng);
         }
     }
-    fclose(file);
-    return data;
+    return H;
+}
+
+/* Read input data from file and convert to matrix form */
+matrix_t* read_data_from_file(const char* filename, matio_format_t format, csv_error_t* error) {
+    matrix_t* data;
+
+    return matio_read(filename, format, 0, &data, NULL, error) ? data : NULL;
 }
 
 /* Print matrix to stdout with specified format */
-void print_matrix(double** matrix, int n, int m) {
-    int i, j;
-    
-    for (i = 0; i < n; i++) {
-        for (j = 0; j < m; j++) {
-            printf("%.4f", matrix[i][j]);
-            if (j < m - 1) printf(",");
+int print_matrix(const matrix_t* matrix) {
+    return textout_matrix(stdout, matrix, 0);
+}
+
+/* Print single-precision matrix to stdout in the format of print_matrix */
+int print_fmatrix(const fmatrix_t* matrix) {
+    return textout_fmatrix(stdout, matrix, 0);
+}
+
+/* Print sparse matrix to stdout, one "row,col,value" line per stored entry */
+int print_sparse_matrix(const csr_matrix_t* matrix) {
+    return textout_sparse(stdout, matrix, 0);
+}
+
+/* Print diagonal matrix to stdout in the format of print_matrix */
+int print_diag_matrix(const diag_matrix_t* matrix) {
+    return textout_diagonal(stdout, matrix, 0);
+}
+
+/* Print packed symmetric matrix to stdout in the format of print_matrix */
+int print_packed_matrix(const packed_matrix_t* matrix) {
+    return textout_packed(stdout, matrix, 0);
+}
+
+/* Send printed output to a text output file; returns 0 on error */
+static int redirect_text_output(const char** output) {
+    if (*output && matio_format_of(*output) == MATIO_TEXT) {
+        if (!freopen(*output, "w", stdout)) return 0;
+        *output = NULL;
+    }
+    return 1;
+}
+
+/* Print a result, or write it to output in the format of its extension; returns 0 on error */
+static int write_result(const matrix_t* matrix, const fmatrix_t* fmatrix, const char* output) {
+    if (!redirect_text_output(&output)) return 0;
+    if (output) return matio_write(output, matio_format_of(output), matrix, fmatrix);
+    return matrix ? print_matrix(matrix) : print_fmatrix(fmatrix);
+}
+
+/* Print a sparse result, or write its "row,col,value" triplets as an nnz x 3 matrix */
+static int write_sparse_result(const csr_matrix_t* matrix, const char* output) {
+    matrix_t* triplets;
+    size_t i, e;
+    int ok;
+
+    if (!redirect_text_output(&output)) return 0;
+    if (!output) return print_sparse_matrix(matrix);
+    triplets = matrix_create(matrix->row_ptr[matrix->rows], 3);
+    if (!triplets) return 0;
+    for (i = 0; i < matrix->rows; i++) {
+        for (e = matrix->row_ptr[i]; e < matrix->row_ptr[i + 1]; e++) {
+            MATRIX_AT(triplets, e, 0) = (double)i;
+            MATRIX_AT(triplets, e, 1) = (double)matrix->col_idx[e];
+            MATRIX_AT(triplets, e, 2) = matrix->values[e];
         }
-        printf("\n");
     }
+    ok = matio_write(output, matio_format_of(output), triplets, NULL);
+    matrix_free(triplets);
+    return ok;
+}
+
+/* Print a diagonal result densely, or write it to output; returns 0 on error */
+static int write_diag_result(const diag_matrix_t* matrix, const char* output) {
+    if (!redirect_text_output(&output)) return 0;
+    if (output) return matio_write_diagonal(output, matio_format_of(output), matrix);
+    return print_diag_matrix(matrix);
+}
+
+/* Run the ddg goal without storing anything of size n x n; returns 0 on error */
+static int run_ddg_goal(const matrix_t* data, const char* output) {
+    diag_matrix_t* result;
+    int ok;
+
+    result = ddg_diagonal(data, 0);
+    if (!result) return 0;
+    ok = write_diag_result(result, output);
+    diag_free(result);
+    return ok;
+}
+
+/* Run a sparse kNN goal and write its result; returns 0 on error */
+static int run_knn_goal(const char* goal, const matrix_t* data, size_t neighbors, const char* output) {
+    csr_matrix_t* result;
+    int ok;
+
+    if (strcmp(goal, "knn_sym") == 0) {
+        result = knn_sym(data, neighbors, 0);
+    } else {
+        result = knn_norm(data, neighbors, 0);
+    }
+    if (!result) return 0;
+    ok = write_sparse_result(result, output);
+    csr_free(result);
+    return ok;
+}
+
+/* Run a single-precision goal and write its result; returns 0 on error */
+static int run_f32_goal(const char* goal, const matrix_t* data, const char* output) {
+    fmatrix_t* result;
+    int ok;
+
+    if (strcmp(goal, "sym_f32") == 0) {
+        result = sym_f32(data, 0);
+    } else {
+        result = norm_f32(data, 0);
+    }
+    if (!result) return 0;
+    ok = write_result(NULL, result, output);
+    fmatrix_free(result);
+    return ok;
+}
+
+/* Print a packed result densely, or write it to output; returns 0 on error */
+static int write_packed_result(const packed_matrix_t* matrix, const char* output) {
+    if (!redirect_text_output(&output)) return 0;
+    if (output) return matio_write_packed(output, matio_format_of(output), matrix);
+    return print_packed_matrix(matrix);
+}
+
+/* Run the sym or norm goal on packed storage, halving the n x n memory; returns 0 on error */
+static int run_packed_goal(const char* goal, const matrix_t* data, const char* output) {
+    packed_matrix_t* result;
+    int ok;
+
+    if (strcmp(goal, "sym") == 0) {
+        result = sym_packed(data, 0);
+    } else {
+        result = norm_packed(data, 0);
+    }
+    if (!result) return 0;
+    ok = write_packed_result(result, output);
+    packed_free(result);
+    return ok;
+}
+
+/* Factorize norm(data) into k clusters and write H; returns 0 on error */
+static int run_symnmf_goal(const matrix_t* data, size_t k, const char* output) {
+    packed_matrix_t* W;
+    matrix_t *H, *result;
+    affinity_t affinity;
+    int ok;
+
+    if (k >= data->rows) return 0;
+    W = norm_packed(data, 0);
+    if (!W) return 0;
+    affinity = affinity_packed(W);
+    H = initialize_h(affinity_mean(&affinity, 0), data->rows, k);
+    result = H ? symnmf_affinity(&affinity, H, 0) : NULL;
+    packed_free(W);
+    matrix_free(H);
+    if (!result) return 0;
+    ok = write_result(result, NULL, output);
+    matrix_free(result);
+    return ok;
 }
 
 /* Main function: handle arguments and execute requested operation */
 int main(int argc, char* argv[]) {
-    const char* goal; const char* filename;
-    int n, d;
-    double** data; double** result;
-    
+    const char* goal; const char* filename; const char* output;
+    const char* positional[3];
+    matrix_t* data;
+    long neighbors; char* end;
+    csv_error_t error;
+    matio_format_t format;
+    int is_knn, is_f32, is_symnmf, has_format, count, i;
+
+    /* Separate the options -o FILE and -f FORMAT from the positional arguments */
+    output = NULL;
+    has_format = 0;
+    count = 0;
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-o") == 0 || strcmp(argv[i], "-f") == 0) {
+            /* An option never falls back to being a positional argument */
+            if (i + 1 >= argc) {
+                fprintf(stderr, "%s needs a value\n", argv[i]);
+                printf("An Error Has Occurred\n"); return 1;
+            }
+            if (argv[i][1] == 'o') {
+                output = argv[++i];
+            } else if (matio_parse_format(argv[++i], &format)) {
+                has_format = 1;
+            } else {
+                fprintf(stderr, "unknown format: %s\n", argv[i]);
+                printf("An Error Has Occurred\n"); return 1;
+            }
+        } else if (count < 3) {
+            positional[count++] = argv[i];
+        } else {
+            count++;
+        }
+    }
+
     /* Validate arguments */
-    if (argc != 3) {
+    if (count != 2 && count != 3) {
         printf("An Error Has Occurred\n"); return 1;
     }
-    
-    goal = argv[1];
-    filename = argv[2];
-    data = read_data_from_file(filename, &n, &d);
-    
+
+    goal = positional[0];
+    filename = positional[1];
+    is_knn = strcmp(goal, "knn_sym") == 0 || strcmp(goal, "knn_norm") == 0;
+    is_f32 = strcmp(goal, "sym_f32") == 0 || strcmp(goal, "norm_f32") == 0;
+    is_symnmf = strcmp(goal, "symnmf") == 0;
+    neighbors = DEFAULT_NEIGHBORS;
+    if (count == 3) {
+        /* The kNN goals take an optional neighbor count, symnmf the cluster count */
+        neighbors = is_knn || is_symnmf ? strtol(positional[2], &end, 10) : 0;
+        if (neighbors <= 0 || *end != '\0') {
+            printf("An Error Has Occurred\n"); return 1;
+        }
+    } else if (is_symnmf) {
+        printf("An Error Has Occurred\n"); return 1;
+    }
+    if (!has_format) format = matio_format_of(filename);
+    data = read_data_from_file(filename, format, &error);
+
     if (!data) {
+        /* The location goes to stderr so stdout keeps the expected output */
+        if (error.line) {
+            fprintf(stderr, "%s:%lu: %s\n", filename, (unsigned long)error.line, error.message);
+        } else if (error.message) {
+            fprintf(stderr, "%s: %s\n", filename, error.message);
+        }
         printf("An Error Has Occurred\n"); return 1;
     }
-    
+
+    if (is_knn) {
+        if (!run_knn_goal(goal, data, (size_t)neighbors, output)) {
+            printf("An Error Has Occurred\n");
+            matrix_free(data); return 1;
+        }
+        matrix_free(data);
+        return 0;
+    }
+    if (is_symnmf) {
+        if (!run_symnmf_goal(data, (size_t)neighbors, output)) {
+            printf("An Error Has Occurred\n");
+            matrix_free(data); return 1;
+        }
+        matrix_free(data);
+        return 0;
+    }
+    if (strcmp(goal, "ddg") == 0) {
+        if (!run_ddg_goal(data, output)) {
+            printf("An Error Has Occurred\n");
+            matrix_free(data); return 1;
+        }
+        matrix_free(data);
+        return 0;
+    }
+    if (is_f32) {
+        if (!run_f32_goal(goal, data, output)) {
+            printf("An Error Has Occurred\n");
+            matrix_free(data); return 1;
+        }
+        matrix_free(data);
+        return 0;
+    }
+
     /* Execute requested operation */
-    result = NULL;
-    if (strcmp(goal, "sym") == 0) {
-        result = sym(data, n, d);
-    } else if (strcmp(goal, "ddg") == 0) {
-        result = ddg(data, n, d);
-    } else if (strcmp(goal, "norm") == 0) {
-        result = norm(data, n, d);
-    } else {
+    if (strcmp(goal, "sym") != 0 && strcmp(goal, "norm") != 0) {
         printf("An Error Has Occurred\n");
-        free_c_array(data, n); return 1;
+        matrix_free(data); return 1;
     }
-    
-    /* Handle result and cleanup */
-    if (!result) {
+    if (!run_packed_goal(goal, data, output)) {
         printf("An Error Has Occurred\n");
-        free_c_array(data, n); return 1;
+        matrix_free(data); return 1;
     }
-    
-    print_matrix(result, n, n);
-    free_c_array(data, n); free_c_array(result, n);
+    matrix_free(data);
     return 0;
 }
\ No newline at end of file
@@ -1,117 +1,348 @@
 #ifndef SYMNMF_H
 #define SYMNMF_H
 
+#include "matrix.h"
+#include "gemm.h"
+#include "sparse.h"
+#include "affinity.h"
+#include "knn.h"
+#include "implicit.h"
+#include "csv.h"
+#include "matio.h"
+
+/*
+ * Temporaries of one symnmf run, reusable across runs with the same n and k
+ * @field n: Number of data points
+ * @field k: Number of clusters
+ * @field WH: W*H (n x k)
+ * @field HtH: H^T*H, one k x k slot per thread (num_slots*k x k)
+ * @field HHtH: H*(H^T*H) (n x k)
+ * @field H_cur: Current iterate (n x k)
+ * @field H_next: Next iterate (n x k), swapped with H_cur each iteration
+ * @field num_chunks: Number of row blocks update_H splits the work into
+ * @field gram_partials: Per-block H^T*H contributions (num_chunks*k x k)
+ * @field delta_partials: Per-block squared change of H (num_chunks)
+ * @field delta: Squared Frobenius change of the last update
+ * @field H_packed: H_cur packed for the packed W*H kernel, or NULL when k is
+ *                  small enough for the row-panel kernel, which packs nothing
+ * @field H_next_packed: H_next packed as it is written, swapped with H_packed
+ * @field HtH_packed: Each slot of HtH packed for the H*(H^T*H) product (num_slots entries), or NULL
+ * @field a_scratch: Scratch of the packed kernel, GEMM_A_SCRATCH doubles per thread, or NULL
+ * @field num_slots: Number of threads the per-thread fields have room for
+ */
+typedef struct symnmf_workspace_t {
+    size_t n;
+    size_t k;
+    matrix_t* WH;
+    matrix_t* HtH;
+    matrix_t* HHtH;
+    matrix_t* H_cur;
+    matrix_t* H_next;
+    size_t num_chunks;
+    matrix_t* gram_partials;
+    double* delta_partials;
+    double delta;
+    gemm_prepacked_t* H_packed;
+    gemm_prepacked_t* H_next_packed;
+    gemm_prepacked_t* HtH_packed;
+    double* a_scratch;
+    size_t num_slots;
+} symnmf_workspace_t;
+
 /* Core algorithm functions */
 
 /*
  * Calculate similarity matrix from input points
+ * Each pair is evaluated once (upper triangle, tiled) and mirrored
  * @param points: Input data points as n x d matrix
- * @param n: Number of data points
- * @param d: Number of dimensions
+ * @param num_threads: Threads to use, or 0 for SYMNMF_NUM_THREADS / OpenMP default
  * @return: n x n similarity matrix, or NULL if error occurs
  */
-double** sym(double** points, int n, int d);
+matrix_t* sym(const matrix_t* points, int num_threads);
 
 /*
- * Calculate diagonal degree matrix
+ * Calculate diagonal degree matrix in dense storage
  * @param points: Input data points as n x d matrix
- * @param n: Number of data points
- * @param d: Number of dimensions
+ * @param num_threads: Threads to use, or 0 for SYMNMF_NUM_THREADS / OpenMP default
  * @return: n x n diagonal degree matrix, or NULL if error occurs
  */
-double** ddg(double** points, int n, int d);
+matrix_t* ddg(const matrix_t* points, int num_threads);
+
+/*
+ * Calculate diagonal degree matrix, storing only the diagonal
+ * Similarities are summed as they are computed, so peak memory is
+ * O(n + n * d); the degrees equal those of ddg bit for bit
+ * @param points: Input data points as n x d matrix
+ * @param num_threads: Threads to use, or 0 for SYMNMF_NUM_THREADS / OpenMP default
+ * @return: Diagonal degree matrix (n x n), or NULL if error occurs
+ */
+diag_matrix_t* ddg_diagonal(const matrix_t* points, int num_threads);
 
 /*
  * Calculate normalized similarity matrix
+ * Peak memory is one n x n matrix plus a degree vector
  * @param points: Input data points as n x d matrix
- * @param n: Number of data points
- * @param d: Number of dimensions
+ * @param num_threads: Threads to use, or 0 for SYMNMF_NUM_THREADS / OpenMP default
  * @return: n x n normalized similarity matrix, or NULL if error occurs
  */
-double** norm(double** points, int n, int d);
+matrix_t* norm(const matrix_t* points, int num_threads);
+
+/*
+ * Calculate similarity matrix in single precision
+ * Distances and exponentials are computed in double and rounded on store,
+ * which halves the memory of the n x n result
+ * @param points: Input data points as n x d matrix
+ * @param num_threads: Threads to use, or 0 for SYMNMF_NUM_THREADS / OpenMP default
+ * @return: n x n single-precision similarity matrix, or NULL if error occurs
+ */
+fmatrix_t* sym_f32(const matrix_t* points, int num_threads);
+
+/*
+ * Calculate normalized similarity matrix in single precision
+ * @param points: Input data points as n x d matrix
+ * @param num_threads: Threads to use, or 0 for SYMNMF_NUM_THREADS / OpenMP default
+ * @return: n x n single-precision normalized similarity matrix, or NULL if error occurs
+ */
+fmatrix_t* norm_f32(const matrix_t* points, int num_threads);
+
+/*
+ * Calculate similarity matrix in packed upper-triangular storage
+ * Roughly halves the memory of sym, so n can grow by about 40%
+ * @param points: Input data points as n x d matrix
+ * @param num_threads: Threads to use, or 0 for SYMNMF_NUM_THREADS / OpenMP default
+ * @return: Packed n x n similarity matrix, or NULL if error occurs
+ */
+packed_matrix_t* sym_packed(const matrix_t* points, int num_threads);
+
+/*
+ * Calculate normalized similarity matrix in packed upper-triangular storage
+ * The stored entries are bitwise equal to the matching entries of norm
+ * @param points: Input data points as n x d matrix
+ * @param num_threads: Threads to use, or 0 for SYMNMF_NUM_THREADS / OpenMP default
+ * @return: Packed n x n normalized similarity matrix, or NULL if error occurs
+ */
+packed_matrix_t* norm_packed(const matrix_t* points, int num_threads);
 
 /*
  * Perform Symmetric NMF algorithm
  * @param W: Input normalized similarity matrix (n x n)
  * @param H: Initial H matrix (n x k)
+ * @param num_threads: Threads to use, or 0 for SYMNMF_NUM_THREADS / OpenMP default
+ * @return: Final H matrix (n x k), or NULL if error occurs
+ */
+matrix_t* symnmf(const matrix_t* W, const matrix_t* H, int num_threads);
+
+/*
+ * Perform Symmetric NMF algorithm on a single-precision similarity matrix
+ * W is read at half the bandwidth of the double path; W * H, H and the
+ * updates stay in double
+ * @param W: Input normalized similarity matrix (n x n), e.g. from norm_f32
+ * @param H: Initial H matrix (n x k)
+ * @param num_threads: Threads to use, or 0 for SYMNMF_NUM_THREADS / OpenMP default
+ * @return: Final H matrix (n x k), or NULL if error occurs
+ */
+matrix_t* symnmf_f32(const fmatrix_t* W, const matrix_t* H, int num_threads);
+
+/*
+ * Perform Symmetric NMF algorithm in mixed precision
+ * The bulk of the iterations multiply by a single-precision copy of W;
+ * once the change ||H_next - H||^2 falls below 1e-3 the remaining
+ * iterations use W itself until the usual convergence test passes, so
+ * the result is a fixed point of the double-precision update. It agrees
+ * with symnmf to within 1e-6 (MIXED_TOLERANCE); the float copy of W makes
+ * peak memory 1.5 times W
+ * @param W: Input normalized similarity matrix (n x n)
+ * @param H: Initial H matrix (n x k)
+ * @param num_threads: Threads to use, or 0 for SYMNMF_NUM_THREADS / OpenMP default
+ * @return: Final H matrix (n x k), or NULL if error occurs
+ */
+matrix_t* symnmf_mixed(const matrix_t* W, const matrix_t* H, int num_threads);
+
+/*
+ * Perform Symmetric NMF algorithm on a sparse similarity matrix
+ * @param W: Input normalized similarity matrix (n x n), e.g. from knn_norm
+ * @param H: Initial H matrix (n x k)
+ * @param num_threads: Threads to use, or 0 for SYMNMF_NUM_THREADS / OpenMP default
+ * @return: Final H matrix (n x k), or NULL if error occurs
+ */
+matrix_t* symnmf_sparse(const csr_matrix_t* W, const matrix_t* H, int num_threads);
+
+/*
+ * Perform Symmetric NMF algorithm on a packed similarity matrix
+ * @param W: Input normalized similarity matrix (n x n), e.g. from norm_packed
+ * @param H: Initial H matrix (n x k)
+ * @param num_threads: Threads to use, or 0 for SYMNMF_NUM_THREADS / OpenMP default
+ * @return: Final H matrix (n x k), or NULL if error occurs
+ */
+matrix_t* symnmf_packed(const packed_matrix_t* W, const matrix_t* H, int num_threads);
+
+/*
+ * Perform Symmetric NMF algorithm without storing W
+ * W = norm(points) is recomputed tile by tile inside every W*H product,
+ * so memory is O(n * d + n * k) at the cost of n^2 exp() per iteration
+ * @param points: Input data points as n x d matrix
+ * @param H: Initial H matrix (n x k)
+ * @param num_threads: Threads to use, or 0 for SYMNMF_NUM_THREADS / OpenMP default
+ * @return: Final H matrix (n x k), or NULL if error occurs
+ */
+matrix_t* symnmf_matrix_free(const matrix_t* points, const matrix_t* H, int num_threads);
+
+/*
+ * Calculate the mean entry of norm(points) without storing the matrix
+ * @param points: Input data points as n x d matrix
+ * @param num_threads: Threads to use, or 0 for SYMNMF_NUM_THREADS / OpenMP default
+ * @return: The mean, or a negative value if error occurs
+ */
+double norm_mean(const matrix_t* points, int num_threads);
+
+/*
+ * Draw the initial H from U[0, 2 * sqrt(mean / k)]
+ * Uses MT19937 seeded with 1234 and filled row by row, which is exactly
+ * what initialize_h_from_mean in symnmf.py does with NumPy
+ * @param mean: Mean of all entries of W
+ * @param n: Number of rows of H
+ * @param k: Number of clusters (columns of H)
+ * @return: Initial H matrix (n x k), or NULL if error occurs
+ */
+matrix_t* initialize_h(double mean, size_t n, size_t k);
+
+/*
+ * Perform Symmetric NMF algorithm on W in any supported storage
+ * @param W: Input normalized similarity matrix (n x n)
+ * @param H: Initial H matrix (n x k)
+ * @param num_threads: Threads to use, or 0 for SYMNMF_NUM_THREADS / OpenMP default
+ * @return: Final H matrix (n x k), or NULL if error occurs
+ */
+matrix_t* symnmf_affinity(const affinity_t* W, const matrix_t* H, int num_threads);
+
+/*
+ * Perform Symmetric NMF algorithm without allocating per-iteration temporaries
+ * @param W: Input normalized similarity matrix (n x n) in any supported storage
+ * @param H: Initial H matrix (n x k)
+ * @param ws: Workspace created for the same n and k
+ * @param num_threads: Threads to use, or 0 for SYMNMF_NUM_THREADS / OpenMP default
+ * @return: Final H matrix (n x k), or NULL if error occurs
+ */
+matrix_t* symnmf_with_workspace(const affinity_t* W, const matrix_t* H, symnmf_workspace_t* ws,
+                                int num_threads);
+
+/*
+ * Allocate a workspace for symnmf runs
  * @param n: Number of data points
  * @param k: Number of clusters
- * @return: Final H matrix (n x k), or NULL if error occurs
+ * @return: New workspace, or NULL if error occurs
+ */
+symnmf_workspace_t* symnmf_workspace_create(size_t n, size_t k);
+
+/*
+ * Make room in a workspace for a team of num_threads threads
+ * Called by the solvers before their parallel region; update_H run by a
+ * larger team needs it first
+ * @param ws: The workspace
+ * @param num_threads: Team size
+ * @return: 1 on success, 0 if memory runs out
  */
-double** symnmf(double** W, double** H, int n, int k);
+int symnmf_workspace_reserve(symnmf_workspace_t* ws, int num_threads);
+
+/*
+ * Free a workspace (NULL is ignored)
+ * @param ws: The workspace to free
+ */
+void symnmf_workspace_free(symnmf_workspace_t* ws);
 
 /* Matrix operation functions */
 
 /*
  * Multiply two matrices: A(n x m) and B(m x p)
- * @param A: First matrix
- * @param B: Second matrix
- * @param n: Number of rows in A
- * @param m: Number of columns in A (and rows in B)
- * @param p: Number of columns in B
+ * @param A: First matrix (n x m)
+ * @param B: Second matrix (m x p)
  * @return: Result matrix (n x p), or NULL if error occurs
  */
-double** matrix_multiply(double** A, double** B, int n, int m, int p);
+matrix_t* matrix_multiply(const matrix_t* A, const matrix_t* B);
 
 /*
  * Create transpose of a matrix
- * @param A: Input matrix
- * @param n: Number of rows in A
- * @param m: Number of columns in A
+ * @param A: Input matrix (n x m)
  * @return: Transposed matrix (m x n), or NULL if error occurs
  */
-double** transpose_matrix(double** A, int n, int m);
+matrix_t* transpose_matrix(const matrix_t* A);
+
+/*
+ * Compute the Gram matrix A^T A
+ * @param A: Input matrix (n x k)
+ * @return: Symmetric result matrix (k x k), or NULL if error occurs
+ */
+matrix_t* gram_matrix(const matrix_t* A);
 
 /*
  * Calculate Frobenius norm of the difference between two matrices
  * @param A: First matrix
- * @param B: Second matrix
- * @param n: Number of rows
- * @param k: Number of columns
+ * @param B: Second matrix of the same shape
  * @return: Frobenius norm value
  */
-double calculate_frobenius_norm(double** A, double** B, int n, int k);
+double calculate_frobenius_norm(const matrix_t* A, const matrix_t* B);
 
 /*
  * Copy contents of one matrix to another
  * @param dest: Destination matrix
- * @param src: Source matrix
- * @param n: Number of rows
- * @param k: Number of columns
+ * @param src: Source matrix of the same shape
  */
-void copy_matrix(double** dest, double** src, int n, int k);
+void copy_matrix(matrix_t* dest, const matrix_t* src);
 
 /*
- * Update H matrix according to symNMF update rule
- * @param W: Normalized similarity matrix
- * @param H: H matrix to update
- * @param n: Number of rows
- * @param k: Number of columns in H
+ * Compute the next H according to symNMF update rule
+ * The denominator is evaluated as H(H^T H) so no n x n temporary is formed
+ * @param W: Normalized similarity matrix (n x n) in any supported storage
+ * @param H: Current H matrix (n x k)
+ * @param H_next: Receives the updated H (n x k), must not alias H
+ * @param ws: Workspace holding the temporaries, reserved for the team size
+ * @return: Squared Frobenius norm of H_next - H
+ * May be called by every thread of an OpenMP team to share the work
  */
-int update_H(double** W, double** H, int n, int k);
+double update_H(const affinity_t* W, const matrix_t* H, matrix_t* H_next, symnmf_workspace_t* ws);
 
 /*
- * Free memory allocated for 2D array
- * @param array: The array to free
- * @param n: Number of rows in the array
+ * Read data from file into matrix
+ * @param filename: Name of input file
+ * @param format: Format of the file, e.g. matio_format_of(filename)
+ * @param error: Receives the line and reason of a failure, may be NULL
+ * @return: Data matrix (n x d), or NULL if error occurs
  */
-void free_c_array(double** array, int n);
+matrix_t* read_data_from_file(const char* filename, matio_format_t format, csv_error_t* error);
 
 /*
- * Read data from file into matrix
- * @param filename: Name of input file
- * @param n: Pointer to store number of rows
- * @param d: Pointer to store number of columns
- * @return: Data matrix, or NULL if error occurs
+ * Print matrix to stdout, 4 decimals per value, through the buffered textout writer
+ * @param matrix: Matrix to print
+ * @return: 1 on success, 0 if memory runs out or writing fails
+ */
+int print_matrix(const matrix_t* matrix);
+
+/*
+ * Print single-precision matrix to stdout in the format of print_matrix
+ * @param matrix: Matrix to print
+ * @return: 1 on success, 0 if memory runs out or writing fails
+ */
+int print_fmatrix(const fmatrix_t* matrix);
+
+/*
+ * Print sparse matrix to stdout as "row,col,value" lines in row order
+ * @param matrix: Matrix to print
+ * @return: 1 on success, 0 if memory runs out or writing fails
+ */
+int print_sparse_matrix(const csr_matrix_t* matrix);
+
+/*
+ * Print diagonal matrix to stdout in the format of print_matrix, zeros included
+ * @param matrix: Matrix to print
+ * @return: 1 on success, 0 if memory runs out or writing fails
  */
-double** read_data_from_file(const char* filename, int* n, int* d);
+int print_diag_matrix(const diag_matrix_t* matrix);
 
 /*
- * Print matrix to stdout
+ * Print packed symmetric matrix to stdout in the format of print_matrix, both triangles
  * @param matrix: Matrix to print
- * @param n: Number of rows
- * @param m: Number of columns
+ * @return: 1 on success, 0 if memory runs out or writing fails
  */
-void print_matrix(double** matrix, int n, int m);
+int print_packed_matrix(const packed_matrix_t* matrix);
 
 #endif /* SYMNMF_H */
\ No newline at end of file
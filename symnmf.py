@@ -2,29 +2,74 @@ import sys
 import numpy as np
 import symnmf  # C extension module
 
-def read_data_file(file_name):
+DEFAULT_NEIGHBORS = 10  # Neighbors per point for the symnmf_knn goal
+BINARY_FORMATS = {".bin": "bin", ".npy": "npy"}  # Extensions read and written by the C module
+
+def file_format(file_name, name=None):
+    """
+    Format of a matrix file: the given one, else the one implied by its extension.
+    Returns:
+        "txt", "bin" or "npy"
+    """
+    if name is not None:
+        return name
+    for extension, name in BINARY_FORMATS.items():
+        if file_name.endswith(extension):
+            return name
+    return "txt"
+
+def read_data_file(file_name, input_format=None):
     """
     Read and parse data from input file.
     Args:
         file_name: Path to input file
+        input_format: "txt", "bin" or "npy", by default from the extension
     Returns:
-        data: List of lists containing the data points
+        data: C-contiguous float64 array of the data points (n x d)
         n: Number of points
         d: Number of dimensions
     """
     try:
-       data = np.loadtxt(file_name, delimiter=',')
-       # Handle 1D case - convert to 2D array
-       if len(data.shape) == 1:
-           data = data.reshape(-1, 1)
-       data = data.tolist()
-       n = len(data)
-       d = len(data[0]) 
+       if file_format(file_name, input_format) != "txt":
+           # Raw binary and .npy files are mapped and copied by the C module
+           data = symnmf.load(file_name, file_format(file_name, input_format))
+           if data is None:
+               raise ValueError
+       else:
+           data = np.loadtxt(file_name, delimiter=',')
+           # Handle 1D case - convert to 2D array
+           if len(data.shape) == 1:
+               data = data.reshape(-1, 1)
+       # The C module reads the array in place
+       data = np.ascontiguousarray(data, dtype=np.float64)
+       n, d = data.shape
        return data, n, d
     except Exception:
        print("An Error Has Occurred") 
        sys.exit(1)
 
+def split_options(argv):
+    """
+    Separate the options -o FILE and -f FORMAT from the positional arguments.
+    Returns:
+        args: Positional arguments, program name first
+        output: Output file, or None for stdout
+        input_format: Input format, or None to use the extension
+    """
+    args, output, input_format = [], None, None
+    i = 0
+    while i < len(argv):
+        if argv[i] == "-o" and i + 1 < len(argv):
+            output = argv[i + 1]
+            i += 2
+        elif argv[i] == "-f" and i + 1 < len(argv) and argv[i + 1] in ("txt", "bin", "npy"):
+            input_format = argv[i + 1]
+            i += 2
+        else:
+            args.append(argv[i])
+            i += 1
+    return args, output, input_format
+
 def validate_args():
     """
     Validate command line arguments.
@@ -32,29 +77,38 @@ def validate_args():
         k: Number of clusters
         goal: Type of calculation to perform
         file_name: Input file path
+        neighbors: Neighbors per point for the symnmf_knn goal
+        output: Output file, or None for stdout
+        input_format: Input format, or None to use the extension
     """
+    args, output, input_format = split_options(sys.argv)
     try:
-        if len(sys.argv) != 4:
+        if len(args) == 5 and args[2] == "symnmf_knn":
+            neighbors = int(args[4])
+            if neighbors <= 0:
+                raise ValueError
+        elif len(args) == 4:
+            neighbors = DEFAULT_NEIGHBORS
+        else:
             print("An Error Has Occurred")
             sys.exit(1)
-        return int(sys.argv[1]), sys.argv[2], sys.argv[3]
+        return int(args[1]), args[2], args[3], neighbors, output, input_format
     except ValueError:
         print("An Error Has Occurred")
         sys.exit(1)
 
-def initialize_h(W, n, k):
+def initialize_h_from_mean(m, n, k):
     """
-    Initialize H matrix for symNMF.
+    Draw the initial H uniformly from [0, 2*sqrt(m/k)].
     Args:
-        W: Normalized similarity matrix
+        m: Mean of all entries of W
         n: Number of points
         k: Number of clusters
     Returns:
         H: Initial H matrix
     """
     np.random.seed(1234)
-    m = np.mean(W)
-    return np.random.uniform(0, 2 * np.sqrt(m/k), size=(n, k)).tolist()
+    return np.random.uniform(0, 2 * np.sqrt(m/k), size=(n, k))
 
 def main():
     """
@@ -62,16 +116,56 @@ def main():
     Reads input, performs calculations based on goal,
     and outputs results.
     """
-    k, goal, file_name = validate_args()
-    data, n, d = read_data_file(file_name)
+    k, goal, file_name, neighbors, output, input_format = validate_args()
+    data, n, d = read_data_file(file_name, input_format)
 
     if goal == "symnmf":
-        W = symnmf.norm(data)
+        W = symnmf.norm_handle(data)
+        if W is None:
+            print("An Error Has Occurred")
+            sys.exit(1)
+        H = initialize_h_from_mean(W.mean(), n, k)
+        result = symnmf.symnmf(W, H, n, k)
+
+    elif goal == "symnmf_f32":
+        W = symnmf.norm_f32_handle(data)
+        if W is None:
+            print("An Error Has Occurred")
+            sys.exit(1)
+        H = initialize_h_from_mean(W.mean(), n, k)
+        result = symnmf.symnmf_f32(W, H, n, k)
+
+    elif goal == "symnmf_mixed":
+        W = symnmf.norm_handle(data)
+        if W is None:
+            print("An Error Has Occurred")
+            sys.exit(1)
+        H = initialize_h_from_mean(W.mean(), n, k)
+        result = symnmf.symnmf_mixed(W, H, n, k)
+
+    elif goal == "symnmf_packed":
+        W = symnmf.norm_packed_handle(data)
         if W is None:
             print("An Error Has Occurred")
             sys.exit(1)
-        H = initialize_h(W, n, k)
+        H = initialize_h_from_mean(W.mean(), n, k)
         result = symnmf.symnmf(W, H, n, k)
+
+    elif goal == "symnmf_knn":
+        W = symnmf.knn_norm_handle(data, neighbors)
+        if W is None:
+            print("An Error Has Occurred")
+            sys.exit(1)
+        H = initialize_h_from_mean(W.mean(), n, k)
+        result = symnmf.symnmf_sparse(W, H, n, k)
+
+    elif goal == "symnmf_matrix_free":
+        m = symnmf.norm_mean(data)
+        if m is None:
+            print("An Error Has Occurred")
+            sys.exit(1)
+        H = initialize_h_from_mean(m, n, k)
+        result = symnmf.symnmf_matrix_free(data, H, n, k)
         
     elif goal == "sym":
         result = symnmf.sym(data)
@@ -81,6 +175,12 @@ def main():
         
     elif goal == "norm":
         result = symnmf.norm(data)
+
+    elif goal == "sym_f32":
+        result = symnmf.sym_f32(data)
+
+    elif goal == "norm_f32":
+        result = symnmf.norm_f32(data)
         
     else:
         print("An Error Has Occurred")
@@ -90,12 +190,20 @@ def main():
         print("An Error Has Occurred")
         sys.exit(1)
     
-    print_matrix(result)
+    if output is None:
+        print_matrix(result)
+    elif file_format(output) != "txt":
+        if symnmf.save(output, result) is None:
+            print("An Error Has Occurred")
+            sys.exit(1)
+    else:
+        with open(output, "w") as out:
+            print_matrix(result, out)
 
-def print_matrix(matrix):
+def print_matrix(matrix, out=sys.stdout):
     # Format and print matrix with 4 decimal places
     for row in matrix:
-        print(','.join(f'{x:.4f}' for x in row))
+        print(','.join(f'{x:.4f}' for x in row), file=out)
 
 if __name__ == "__main__":
     main()
\ No newline at end of file
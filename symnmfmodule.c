@@ -1,208 +1,1244 @@
 #define PY_SSIZE_T_CLEAN
 #include <Python.h>
+#include <stdint.h>
+#include <string.h>
 #include "symnmf.h"
 
-/* Convert Python list to C array 
+/* Convert Python list to C matrix
  * Input: Python list and its dimensions
- * Output: Dynamically allocated 2D array or NULL if memory allocation fails
+ * Output: Newly allocated matrix or NULL if memory allocation fails
  */
-static double** py_list_to_c_array(PyObject* py_list, int n, int d) {
-    /* Allocate memory for array of pointers */
-    double** array = (double**)malloc(n * sizeof(double*));
-    if (!array) {
+static matrix_t* py_list_to_matrix(PyObject* py_list, Py_ssize_t n, Py_ssize_t d) {
+    /* Allocate one contiguous buffer for the whole matrix */
+    matrix_t* matrix = matrix_create((size_t)n, (size_t)d);
+    if (!matrix) {
         return NULL;
     }
-    /* Allocate memory for each row and copy data */
-    for (int i = 0; i < n; i++) {
-        array[i] = (double*)malloc(d * sizeof(double));
-        if (!array[i]) {
-            free_c_array(array, i);  /* Free previously allocated memory */
-            return NULL;
-        }
+    /* Copy data row by row */
+    for (Py_ssize_t i = 0; i < n; i++) {
+        double* row = MATRIX_ROW(matrix, i);
         PyObject* py_row = PyList_GetItem(py_list, i);
-        for (int j = 0; j < d; j++) {
-            array[i][j] = PyFloat_AsDouble(PyList_GetItem(py_row, j));
+        for (Py_ssize_t j = 0; j < d; j++) {
+            row[j] = PyFloat_AsDouble(PyList_GetItem(py_row, j));
         }
     }
-    return array;
+    return matrix;
 }
 
-/* Convert C array to Python list 
- * Input: C 2D array and its dimensions
+/* Convert C matrix to Python list
+ * Input: C matrix
  * Output: Python list or NULL if creation fails
  */
-static PyObject* c_array_to_py_list(double** array, int n, int d) {
+static PyObject* matrix_to_py_list(const matrix_t* matrix) {
     /* Create new Python list */
-    PyObject* py_list = PyList_New(n);
+    PyObject* py_list = PyList_New((Py_ssize_t)matrix->rows);
     if (!py_list) {
         return NULL;
     }
     /* Create each row and copy data */
-    for (int i = 0; i < n; i++) {
-        PyObject* py_row = PyList_New(d);
+    for (size_t i = 0; i < matrix->rows; i++) {
+        const double* row = MATRIX_ROW(matrix, i);
+        PyObject* py_row = PyList_New((Py_ssize_t)matrix->cols);
         if (!py_row) {
             Py_DECREF(py_list);
             return NULL;
         }
-        for (int j = 0; j < d; j++) {
-            PyObject* py_float = PyFloat_FromDouble(array[i][j]);
+        for (size_t j = 0; j < matrix->cols; j++) {
+            PyObject* py_float = PyFloat_FromDouble(row[j]);
             if (!py_float) {
                 Py_DECREF(py_row);
                 Py_DECREF(py_list);
                 return NULL;
             }
-            PyList_SET_ITEM(py_row, j, py_float);
+            PyList_SET_ITEM(py_row, (Py_ssize_t)j, py_float);
         }
-        PyList_SET_ITEM(py_list, i, py_row);
+        PyList_SET_ITEM(py_list, (Py_ssize_t)i, py_row);
     }
     return py_list;
 }
 
-/* Python wrapper for sym function
- * Converts Python input to C, calls sym, converts result back to Python
+/* Convert Python list to single-precision C matrix
+ * Input: Python list and its dimensions
+ * Output: Newly allocated matrix or NULL if memory allocation fails
  */
-static PyObject* py_sym(PyObject* self, PyObject* args) {
+static fmatrix_t* py_list_to_fmatrix(PyObject* py_list, Py_ssize_t n, Py_ssize_t d) {
+    fmatrix_t* matrix = fmatrix_create((size_t)n, (size_t)d);
+    if (!matrix) {
+        return NULL;
+    }
+    /* Copy data row by row, rounding to single precision */
+    for (Py_ssize_t i = 0; i < n; i++) {
+        float* row = FMATRIX_ROW(matrix, i);
+        PyObject* py_row = PyList_GetItem(py_list, i);
+        for (Py_ssize_t j = 0; j < d; j++) {
+            row[j] = (float)PyFloat_AsDouble(PyList_GetItem(py_row, j));
+        }
+    }
+    return matrix;
+}
+
+/* Convert single-precision C matrix to Python list
+ * Input: C matrix
+ * Output: Python list or NULL if creation fails
+ */
+static PyObject* fmatrix_to_py_list(const fmatrix_t* matrix) {
+    PyObject* py_list = PyList_New((Py_ssize_t)matrix->rows);
+    if (!py_list) {
+        return NULL;
+    }
+    for (size_t i = 0; i < matrix->rows; i++) {
+        const float* row = FMATRIX_ROW(matrix, i);
+        PyObject* py_row = PyList_New((Py_ssize_t)matrix->cols);
+        if (!py_row) {
+            Py_DECREF(py_list);
+            return NULL;
+        }
+        for (size_t j = 0; j < matrix->cols; j++) {
+            PyObject* py_float = PyFloat_FromDouble((double)row[j]);
+            if (!py_float) {
+                Py_DECREF(py_row);
+                Py_DECREF(py_list);
+                return NULL;
+            }
+            PyList_SET_ITEM(py_row, (Py_ssize_t)j, py_float);
+        }
+        PyList_SET_ITEM(py_list, (Py_ssize_t)i, py_row);
+    }
+    return py_list;
+}
+
+/* Convert C sparse matrix to a Python (row_ptr, col_idx, values) tuple of lists
+ * Input: C CSR matrix
+ * Output: Python tuple or NULL if creation fails
+ */
+static PyObject* csr_to_py_tuple(const csr_matrix_t* matrix) {
+    PyObject* py_row_ptr = PyList_New((Py_ssize_t)matrix->rows + 1);
+    PyObject* py_col_idx = PyList_New((Py_ssize_t)matrix->nnz);
+    PyObject* py_values = PyList_New((Py_ssize_t)matrix->nnz);
+    if (!py_row_ptr || !py_col_idx || !py_values) {
+        Py_XDECREF(py_row_ptr);
+        Py_XDECREF(py_col_idx);
+        Py_XDECREF(py_values);
+        return NULL;
+    }
+    for (size_t i = 0; i <= matrix->rows; i++) {
+        PyObject* py_int = PyLong_FromSize_t(matrix->row_ptr[i]);
+        if (!py_int) goto fail;
+        PyList_SET_ITEM(py_row_ptr, (Py_ssize_t)i, py_int);
+    }
+    for (size_t e = 0; e < matrix->nnz; e++) {
+        PyObject* py_int = PyLong_FromSize_t(matrix->col_idx[e]);
+        if (!py_int) goto fail;
+        PyList_SET_ITEM(py_col_idx, (Py_ssize_t)e, py_int);
+        PyObject* py_float = PyFloat_FromDouble(matrix->values[e]);
+        if (!py_float) goto fail;
+        PyList_SET_ITEM(py_values, (Py_ssize_t)e, py_float);
+    }
+    return Py_BuildValue("(NNN)", py_row_ptr, py_col_idx, py_values);
+fail:
+    Py_DECREF(py_row_ptr);
+    Py_DECREF(py_col_idx);
+    Py_DECREF(py_values);
+    return NULL;
+}
+
+/* Convert a Python (row_ptr, col_idx, values) tuple to a C sparse matrix
+ * Input: Python tuple and the matrix dimension n
+ * Output: Newly allocated n x n CSR matrix or NULL if the input is malformed
+ */
+static csr_matrix_t* py_tuple_to_csr(PyObject* py_tuple, Py_ssize_t n) {
+    PyObject *py_row_ptr, *py_col_idx, *py_values;
+    if (!PyArg_ParseTuple(py_tuple, "OOO", &py_row_ptr, &py_col_idx, &py_values)) {
+        PyErr_Clear();
+        return NULL;
+    }
+    if (!PyList_Check(py_row_ptr) || !PyList_Check(py_col_idx) || !PyList_Check(py_values) ||
+        PyList_Size(py_row_ptr) != n + 1 || PyList_Size(py_col_idx) != PyList_Size(py_values)) {
+        return NULL;
+    }
+    Py_ssize_t nnz = PyList_Size(py_values);
+    csr_matrix_t* matrix = csr_create((size_t)n, (size_t)n, (size_t)nnz);
+    if (!matrix) {
+        return NULL;
+    }
+    for (Py_ssize_t i = 0; i <= n; i++) {
+        matrix->row_ptr[i] = PyLong_AsSize_t(PyList_GetItem(py_row_ptr, i));
+    }
+    for (Py_ssize_t e = 0; e < nnz; e++) {
+        matrix->col_idx[e] = PyLong_AsSize_t(PyList_GetItem(py_col_idx, e));
+        matrix->values[e] = PyFloat_AsDouble(PyList_GetItem(py_values, e));
+    }
+    /* Reject offsets and indices that would read out of bounds */
+    int valid = !PyErr_Occurred() && matrix->row_ptr[0] == 0 && matrix->row_ptr[n] == (size_t)nnz;
+    for (Py_ssize_t i = 0; valid && i < n; i++) {
+        valid = matrix->row_ptr[i] <= matrix->row_ptr[i + 1];
+    }
+    for (Py_ssize_t e = 0; valid && e < nnz; e++) {
+        valid = matrix->col_idx[e] < (size_t)n;
+    }
+    if (!valid) {
+        PyErr_Clear();
+        csr_free(matrix);
+        return NULL;
+    }
+    return matrix;
+}
+
+/* Python object owning a C result matrix
+ * Exposes the matrix through the buffer protocol, so numpy.asarray wraps
+ * it without copying and keeps it alive for as long as the array exists.
+ * result_to_array packs the rows first, so the buffer is C-contiguous.
+ */
+typedef struct {
+    PyObject_HEAD
+    matrix_t* matrix;    /* Double-precision result, or NULL */
+    fmatrix_t* fmatrix;  /* Single-precision result, or NULL */
+    Py_ssize_t shape[2];
+    Py_ssize_t strides[2];
+} MatrixObject;
+
+static void Matrix_dealloc(MatrixObject* self) {
+    matrix_free(self->matrix);
+    fmatrix_free(self->fmatrix);
+    Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+static int Matrix_getbuffer(MatrixObject* self, Py_buffer* view, int flags) {
+    int is_f32 = self->fmatrix != NULL;
+    Py_ssize_t itemsize = is_f32 ? (Py_ssize_t)sizeof(float) : (Py_ssize_t)sizeof(double);
+    int contiguous = self->shape[0] <= 1 || self->strides[0] == self->shape[1] * itemsize;
+    int wants_contiguous = (flags & PyBUF_STRIDES) != PyBUF_STRIDES ||
+                           (flags & PyBUF_C_CONTIGUOUS) == PyBUF_C_CONTIGUOUS ||
+                           (flags & PyBUF_ANY_CONTIGUOUS) == PyBUF_ANY_CONTIGUOUS;
+    if ((flags & PyBUF_F_CONTIGUOUS) == PyBUF_F_CONTIGUOUS || (wants_contiguous && !contiguous)) {
+        PyErr_SetString(PyExc_BufferError, "symnmf.Matrix rows are padded; request a strided buffer");
+        view->obj = NULL;
+        return -1;
+    }
+    view->buf = is_f32 ? (void*)self->fmatrix->data : (void*)self->matrix->data;
+    view->obj = (PyObject*)self;
+    Py_INCREF(self);
+    view->len = self->shape[0] * self->shape[1] * itemsize;
+    view->readonly = 0;
+    view->itemsize = itemsize;
+    view->format = (flags & PyBUF_FORMAT) ? (is_f32 ? "f" : "d") : NULL;
+    view->ndim = 2;
+    view->shape = (flags & PyBUF_ND) == PyBUF_ND ? self->shape : NULL;
+    view->strides = (flags & PyBUF_STRIDES) == PyBUF_STRIDES ? self->strides : NULL;
+    view->suboffsets = NULL;
+    view->internal = NULL;
+    return 0;
+}
+
+static PyBufferProcs Matrix_as_buffer = {
+    (getbufferproc)Matrix_getbuffer,
+    NULL
+};
+
+static PyTypeObject MatrixType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "symnmf.Matrix",
+    .tp_basicsize = sizeof(MatrixObject),
+    .tp_dealloc = (destructor)Matrix_dealloc,
+    .tp_as_buffer = &Matrix_as_buffer,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = "Matrix computed by the symnmf module, readable through the buffer protocol",
+};
+
+/* NumPy, imported once by PyInit_symnmf, or NULL if it is not installed */
+static PyObject* numpy_module = NULL;
+
+/* Drop the row padding of a result in place, so its buffer is C-contiguous
+ * Rows only move toward the start, so memmove in row order is safe and
+ * no second n x cols allocation is needed
+ */
+static void pack_rows(void* data, size_t rows, size_t cols, size_t* stride, size_t itemsize) {
+    char* base = (char*)data;
+    if (*stride == cols) {
+        return;
+    }
+    for (size_t i = 1; i < rows; i++) {
+        memmove(base + i * cols * itemsize, base + i * *stride * itemsize, cols * itemsize);
+    }
+    *stride = cols;
+}
+
+/* Wrap a C result in a NumPy array without copying
+ * Input: exactly one of matrix and fmatrix, whose ownership is taken;
+ *        its rows are packed so the array is C-contiguous
+ * Output: numpy.asarray of a symnmf.Matrix owning the result (the Matrix
+ *         itself if NumPy is not installed), or NULL if creation fails
+ */
+static PyObject* result_to_array(matrix_t* matrix, fmatrix_t* fmatrix) {
+    MatrixObject* owner = PyObject_New(MatrixObject, &MatrixType);
+    if (!owner) {
+        matrix_free(matrix);
+        fmatrix_free(fmatrix);
+        return NULL;
+    }
+    owner->matrix = matrix;
+    owner->fmatrix = fmatrix;
+    if (matrix) {
+        pack_rows(matrix->data, matrix->rows, matrix->cols, &matrix->stride, sizeof(double));
+        owner->shape[0] = (Py_ssize_t)matrix->rows;
+        owner->shape[1] = (Py_ssize_t)matrix->cols;
+        owner->strides[0] = (Py_ssize_t)(matrix->stride * sizeof(double));
+        owner->strides[1] = (Py_ssize_t)sizeof(double);
+    } else {
+        pack_rows(fmatrix->data, fmatrix->rows, fmatrix->cols, &fmatrix->stride, sizeof(float));
+        owner->shape[0] = (Py_ssize_t)fmatrix->rows;
+        owner->shape[1] = (Py_ssize_t)fmatrix->cols;
+        owner->strides[0] = (Py_ssize_t)(fmatrix->stride * sizeof(float));
+        owner->strides[1] = (Py_ssize_t)sizeof(float);
+    }
+    if (!numpy_module) {
+        return (PyObject*)owner;
+    }
+    PyObject* array = PyObject_CallMethod(numpy_module, "asarray", "O", (PyObject*)owner);
+    Py_DECREF(owner);
+    return array;
+}
+
+/* Convert a double-precision C result for Python, taking ownership
+ * Input: C matrix and whether the caller passed its matrices as buffers
+ * Output: NumPy array (as_array) or list of lists, or NULL if creation fails
+ */
+static PyObject* matrix_result(matrix_t* matrix, int as_array) {
+    if (as_array) {
+        return result_to_array(matrix, NULL);
+    }
+    PyObject* py_result = matrix_to_py_list(matrix);
+    matrix_free(matrix);
+    return py_result;
+}
+
+/* Convert a single-precision C result for Python, taking ownership
+ * Input: C matrix and whether the caller passed its matrices as buffers
+ * Output: NumPy array (as_array) or list of lists, or NULL if creation fails
+ */
+static PyObject* fmatrix_result(fmatrix_t* matrix, int as_array) {
+    if (as_array) {
+        return result_to_array(NULL, matrix);
+    }
+    PyObject* py_result = fmatrix_to_py_list(matrix);
+    fmatrix_free(matrix);
+    return py_result;
+}
+
+/* Python handle owning a normalized similarity matrix in C storage
+ * Lets W go from norm_handle/norm_f32_handle/norm_packed_handle/knn_norm_handle straight
+ * into the solvers without ever being converted to Python objects.
+ */
+typedef struct {
+    PyObject_HEAD
+    matrix_t* dense;       /* Owned dense W, or NULL */
+    fmatrix_t* dense32;    /* Owned single-precision W, or NULL */
+    csr_matrix_t* csr;     /* Owned sparse W, or NULL */
+    packed_matrix_t* packed; /* Owned packed upper-triangular W, or NULL */
+    affinity_t affinity;   /* Reference to whichever of the above is set */
+} AffinityObject;
+
+static void Affinity_dealloc(AffinityObject* self) {
+    matrix_free(self->dense);
+    fmatrix_free(self->dense32);
+    csr_free(self->csr);
+    packed_free(self->packed);
+    Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+static PyObject* Affinity_get_n(AffinityObject* self, void* closure) {
+    return PyLong_FromSize_t(self->affinity.n);
+}
+
+static PyObject* Affinity_get_kind(AffinityObject* self, void* closure) {
+    switch (self->affinity.kind) {
+    case AFFINITY_DENSE_F32:
+        return PyUnicode_FromString("dense_f32");
+    case AFFINITY_CSR:
+        return PyUnicode_FromString("csr");
+    case AFFINITY_PACKED:
+        return PyUnicode_FromString("packed");
+    default:
+        return PyUnicode_FromString("dense");
+    }
+}
+
+/* Mean of all n^2 entries of W, e.g. to initialize H */
+static PyObject* Affinity_mean(AffinityObject* self, PyObject* args) {
+    int num_threads = 0;
+    if (!PyArg_ParseTuple(args, "|i", &num_threads)) return NULL;
+    double mean;
+    Py_BEGIN_ALLOW_THREADS
+    mean = affinity_mean(&self->affinity, num_threads);
+    Py_END_ALLOW_THREADS
+    if (mean < 0.0) {
+        Py_RETURN_NONE;
+    }
+    return PyFloat_FromDouble(mean);
+}
+
+static PyGetSetDef Affinity_getset[] = {
+    {"n", (getter)Affinity_get_n, NULL, "Number of rows and columns of W", NULL},
+    {"kind", (getter)Affinity_get_kind, NULL, "Storage of W: 'dense', 'dense_f32', 'csr' or 'packed'", NULL},
+    {NULL, NULL, NULL, NULL, NULL}
+};
+
+static PyMethodDef Affinity_methods[] = {
+    {"mean", (PyCFunction)Affinity_mean, METH_VARARGS,
+     "Mean of all entries of W. mean([num_threads])"},
+    {NULL, NULL, 0, NULL}
+};
+
+static PyTypeObject AffinityType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "symnmf.Affinity",
+    .tp_basicsize = sizeof(AffinityObject),
+    .tp_dealloc = (destructor)Affinity_dealloc,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = "Opaque normalized similarity matrix held in C storage",
+    .tp_methods = Affinity_methods,
+    .tp_getset = Affinity_getset,
+};
+
+/* Wrap a C similarity matrix in a handle, taking ownership
+ * Input: exactly one of dense, dense32, csr and packed
+ * Output: New symnmf.Affinity or NULL if creation fails
+ */
+static PyObject* affinity_to_handle(matrix_t* dense, fmatrix_t* dense32, csr_matrix_t* csr,
+                                    packed_matrix_t* packed) {
+    AffinityObject* handle = PyObject_New(AffinityObject, &AffinityType);
+    if (!handle) {
+        matrix_free(dense);
+        fmatrix_free(dense32);
+        csr_free(csr);
+        packed_free(packed);
+        return NULL;
+    }
+    handle->dense = dense;
+    handle->dense32 = dense32;
+    handle->csr = csr;
+    handle->packed = packed;
+    if (dense) {
+        handle->affinity = affinity_dense(dense);
+    } else if (dense32) {
+        handle->affinity = affinity_dense_f32(dense32);
+    } else if (csr) {
+        handle->affinity = affinity_csr(csr);
+    } else {
+        handle->affinity = affinity_packed(packed);
+    }
+    return (PyObject*)handle;
+}
+
+/* Matrix argument from Python
+ * Either a view of the caller's buffer (held in buffer until released)
+ * or an owned copy converted from a list or from a buffer of the other
+ * precision or layout.
+ */
+typedef struct {
+    matrix_t view;
+    matrix_t* copy;
+    fmatrix_t fview;
+    fmatrix_t* fcopy;
+    Py_buffer buffer;
+    int has_buffer;
+    int from_buffer;
+} matrix_arg_t;
+
+/* Element type of a buffer: 'd' for float64, 'f' for float32, 0 if unsupported */
+static char buffer_type(const Py_buffer* buffer) {
+    const char* format = buffer->format ? buffer->format : "B";
+    if (*format == '@' || *format == '=') format++;
+    if (format[0] == 'd' && format[1] == '\0' && buffer->itemsize == sizeof(double)) return 'd';
+    if (format[0] == 'f' && format[1] == '\0' && buffer->itemsize == sizeof(float)) return 'f';
+    return 0;
+}
+
+/* Element (i, j) of a 2-D float64 or float32 buffer, for any strides */
+static double buffer_at(const Py_buffer* buffer, char type, Py_ssize_t i, Py_ssize_t j) {
+    const char* p = (const char*)buffer->buf + i * buffer->strides[0] + j * buffer->strides[1];
+    if (type == 'd') {
+        double value;
+        memcpy(&value, p, sizeof(value));
+        return value;
+    }
+    float value;
+    memcpy(&value, p, sizeof(value));
+    return (double)value;
+}
+
+/* Release whatever a matrix argument holds */
+static void matrix_arg_release(matrix_arg_t* arg) {
+    if (arg->has_buffer) {
+        PyBuffer_Release(&arg->buffer);
+        arg->has_buffer = 0;
+    }
+    matrix_free(arg->copy);
+    fmatrix_free(arg->fcopy);
+    arg->copy = NULL;
+    arg->fcopy = NULL;
+}
+
+/* Acquire obj as a 2-D float64/float32 buffer of the expected shape
+ * Input: object, expected rows and columns (negative for any), argument to fill
+ * Output: element type of the held buffer, 0 if obj is not such a buffer,
+ *         -1 if it is a buffer of the wrong type or shape
+ */
+static int matrix_arg_buffer(PyObject* obj, Py_ssize_t rows, Py_ssize_t cols, matrix_arg_t* arg) {
+    arg->copy = NULL;
+    arg->fcopy = NULL;
+    arg->has_buffer = 0;
+    arg->from_buffer = 0;
+    if (!PyObject_CheckBuffer(obj)) return 0;
+    if (PyObject_GetBuffer(obj, &arg->buffer, PyBUF_STRIDES | PyBUF_FORMAT) < 0) {
+        PyErr_Clear();
+        return -1;
+    }
+    arg->has_buffer = 1;
+    arg->from_buffer = 1;
+    Py_buffer* b = &arg->buffer;
+    char type = buffer_type(b);
+    if (!type || b->ndim != 2 || b->shape[0] <= 0 || b->shape[1] <= 0 ||
+        (rows >= 0 && b->shape[0] != rows) || (cols >= 0 && b->shape[1] != cols)) {
+        matrix_arg_release(arg);
+        return -1;
+    }
+    return type;
+}
+
+/* Whether a held buffer can be used in place as rows of the given element size */
+static int buffer_is_direct(const Py_buffer* buffer, Py_ssize_t itemsize) {
+    return buffer->strides[1] == itemsize && buffer->strides[0] >= 0 &&
+           buffer->strides[0] % itemsize == 0 && (uintptr_t)buffer->buf % itemsize == 0;
+}
+
+/* Double-precision matrix from a list of lists or any 2-D float64/float32 buffer
+ * A C-contiguous (or row-strided) float64 buffer is used in place; anything
+ * else is converted into a copy.
+ * Input: object, expected rows and columns (negative for any), argument to fill
+ * Output: the matrix, valid until matrix_arg_release, or NULL if obj does not fit
+ */
+static const matrix_t* matrix_arg_get(PyObject* obj, Py_ssize_t rows, Py_ssize_t cols, matrix_arg_t* arg) {
+    int type = matrix_arg_buffer(obj, rows, cols, arg);
+    if (type < 0) return NULL;
+    if (type) {
+        Py_buffer* b = &arg->buffer;
+        if (type == 'd' && buffer_is_direct(b, sizeof(double))) {
+            arg->view.data = (double*)b->buf;
+            arg->view.rows = (size_t)b->shape[0];
+            arg->view.cols = (size_t)b->shape[1];
+            arg->view.stride = (size_t)(b->strides[0] / (Py_ssize_t)sizeof(double));
+            return &arg->view;
+        }
+        arg->copy = matrix_create((size_t)b->shape[0], (size_t)b->shape[1]);
+        if (arg->copy) {
+            for (Py_ssize_t i = 0; i < b->shape[0]; i++) {
+                for (Py_ssize_t j = 0; j < b->shape[1]; j++) {
+                    MATRIX_AT(arg->copy, i, j) = buffer_at(b, (char)type, i, j);
+                }
+            }
+        }
+        PyBuffer_Release(b);
+        arg->has_buffer = 0;
+        return arg->copy;
+    }
+    if (!PyList_Check(obj) || PyList_Size(obj) <= 0 || !PyList_Check(PyList_GetItem(obj, 0)) ||
+        (rows >= 0 && PyList_Size(obj) != rows)) return NULL;
+    if (rows < 0) rows = PyList_Size(obj);
+    if (cols < 0) cols = PyList_Size(PyList_GetItem(obj, 0));
+    arg->copy = py_list_to_matrix(obj, rows, cols);
+    return arg->copy;
+}
+
+/* Single-precision matrix from a list of lists or any 2-D float64/float32 buffer
+ * A C-contiguous (or row-strided) float32 buffer is used in place; anything
+ * else is rounded into a copy.
+ * Input: object, expected rows and columns (negative for any), argument to fill
+ * Output: the matrix, valid until matrix_arg_release, or NULL if obj does not fit
+ */
+static const fmatrix_t* fmatrix_arg_get(PyObject* obj, Py_ssize_t rows, Py_ssize_t cols, matrix_arg_t* arg) {
+    int type = matrix_arg_buffer(obj, rows, cols, arg);
+    if (type < 0) return NULL;
+    if (type) {
+        Py_buffer* b = &arg->buffer;
+        if (type == 'f' && buffer_is_direct(b, sizeof(float))) {
+            arg->fview.data = (float*)b->buf;
+            arg->fview.rows = (size_t)b->shape[0];
+            arg->fview.cols = (size_t)b->shape[1];
+            arg->fview.stride = (size_t)(b->strides[0] / (Py_ssize_t)sizeof(float));
+            return &arg->fview;
+        }
+        arg->fcopy = fmatrix_create((size_t)b->shape[0], (size_t)b->shape[1]);
+        if (arg->fcopy) {
+            for (Py_ssize_t i = 0; i < b->shape[0]; i++) {
+                for (Py_ssize_t j = 0; j < b->shape[1]; j++) {
+                    FMATRIX_AT(arg->fcopy, i, j) = (float)buffer_at(b, (char)type, i, j);
+                }
+            }
+        }
+        PyBuffer_Release(b);
+        arg->has_buffer = 0;
+        return arg->fcopy;
+    }
+    if (!PyList_Check(obj) || PyList_Size(obj) <= 0 || !PyList_Check(PyList_GetItem(obj, 0)) ||
+        (rows >= 0 && PyList_Size(obj) != rows)) return NULL;
+    if (rows < 0) rows = PyList_Size(obj);
+    if (cols < 0) cols = PyList_Size(PyList_GetItem(obj, 0));
+    arg->fcopy = py_list_to_fmatrix(obj, rows, cols);
+    return arg->fcopy;
+}
+
+/* Python wrapper for sym, ddg and norm
+ * Converts Python input to C, calls the builder, converts result back to Python
+ */
+static PyObject* py_points_common(PyObject* args, matrix_t* (*builder)(const matrix_t*, int)) {
     PyObject *py_points;
+    matrix_arg_t points_arg;
+    int num_threads = 0;
     /* Parse Python arguments */
-    if (!PyArg_ParseTuple(args, "O", &py_points)) return NULL;
-    int n = PyList_Size(py_points);
-    int d = PyList_Size(PyList_GetItem(py_points, 0));
+    if (!PyArg_ParseTuple(args, "O|i", &py_points, &num_threads)) return NULL;
     
-    /* Convert input to C array */
-    double **points = py_list_to_c_array(py_points, n, d);
+    /* Convert input to C matrix */
+    const matrix_t *points = matrix_arg_get(py_points, -1, -1, &points_arg);
     if (!points) {
+        matrix_arg_release(&points_arg);
         Py_RETURN_NONE;
     }
     
-    /* Call C function */
-    double **result = sym(points, n, d);
+    /* Call C function without holding the GIL */
+    matrix_t *result;
+    Py_BEGIN_ALLOW_THREADS
+    result = builder(points, num_threads);
+    Py_END_ALLOW_THREADS
+    matrix_arg_release(&points_arg);
     if (!result) {
-        free_c_array(points, n);
         Py_RETURN_NONE;
     }
     
     /* Convert result back to Python */
-    PyObject* py_result = c_array_to_py_list(result, n, n);
-    free_c_array(points, n);
-    free_c_array(result, n);
+    PyObject* py_result = matrix_result(result, points_arg.from_buffer);
     if (!py_result) {
         Py_RETURN_NONE;
     }
     return py_result;
 }
 
-/* Python wrapper for ddg function
- * Converts Python input to C, calls ddg, converts result back to Python
- */
+/* Python wrapper for sym function */
+static PyObject* py_sym(PyObject* self, PyObject* args) {
+    return py_points_common(args, sym);
+}
+
+/* Python wrapper for ddg function */
 static PyObject* py_ddg(PyObject* self, PyObject* args) {
+    return py_points_common(args, ddg);
+}
+
+/* Python wrapper for norm function */
+static PyObject* py_norm(PyObject* self, PyObject* args) {
+    return py_points_common(args, norm);
+}
+
+/* Run a solver on a symnmf.Affinity handle
+ * Input: handle, Python H, dimensions, thread count and whether the
+ *        mixed-precision solver (dense W only) was requested
+ * Output: Final H for Python, or None if error occurs; raises TypeError
+ *         if the mixed solver is given a handle that is not dense
+ */
+static PyObject* py_symnmf_handle(AffinityObject* W, PyObject* py_H, int n, int k,
+                                  int num_threads, int mixed) {
+    matrix_arg_t H_arg;
+    if (mixed && !W->dense) {
+        PyErr_SetString(PyExc_TypeError, "symnmf_mixed needs a dense double-precision symnmf.Affinity (from norm_handle)");
+        return NULL;
+    }
+    if (W->affinity.n != (size_t)n) {
+        Py_RETURN_NONE;
+    }
+    
+    /* Convert H to C matrix */
+    const matrix_t *H = matrix_arg_get(py_H, n, k, &H_arg);
+    if (!H) {
+        matrix_arg_release(&H_arg);
+        Py_RETURN_NONE;
+    }
+    
+    /* Call C function without holding the GIL; the handle keeps W alive */
+    matrix_t *result;
+    Py_BEGIN_ALLOW_THREADS
+    result = mixed ? symnmf_mixed(W->dense, H, num_threads) : symnmf_affinity(&W->affinity, H, num_threads);
+    Py_END_ALLOW_THREADS
+    matrix_arg_release(&H_arg);
+    if (!result) {
+        Py_RETURN_NONE;
+    }
+    
+    /* Convert result back to Python */
+    PyObject* py_result = matrix_result(result, H_arg.from_buffer);
+    if (!py_result) {
+        Py_RETURN_NONE;
+    }
+    return py_result;
+}
+
+/* Python wrapper for symnmf and symnmf_mixed
+ * Converts Python input to C, calls the solver, converts result back to Python
+ */
+static PyObject* py_symnmf_common(PyObject* args,
+                                  matrix_t* (*solver)(const matrix_t*, const matrix_t*, int)) {
+    PyObject *py_W, *py_H;
+    matrix_arg_t W_arg, H_arg;
+    int n, k;
+    int num_threads = 0;
+    /* Parse Python arguments */
+    if (!PyArg_ParseTuple(args, "OOii|i", &py_W, &py_H, &n, &k, &num_threads)) return NULL;
+    if (PyObject_TypeCheck(py_W, &AffinityType)) {
+        return py_symnmf_handle((AffinityObject*)py_W, py_H, n, k, num_threads, solver == symnmf_mixed);
+    }
+    
+    /* Convert inputs to C matrices */
+    const matrix_t *W = matrix_arg_get(py_W, n, n, &W_arg);
+    if (!W) {
+        matrix_arg_release(&W_arg);
+        Py_RETURN_NONE;
+    }
+    
+    const matrix_t *H = matrix_arg_get(py_H, n, k, &H_arg);
+    if (!H) {
+        matrix_arg_release(&W_arg);
+        matrix_arg_release(&H_arg);
+        Py_RETURN_NONE;
+    }
+    
+    /* Call C function without holding the GIL */
+    matrix_t *result;
+    Py_BEGIN_ALLOW_THREADS
+    result = solver(W, H, num_threads);
+    Py_END_ALLOW_THREADS
+    matrix_arg_release(&W_arg);
+    matrix_arg_release(&H_arg);
+    if (!result) {
+        Py_RETURN_NONE;
+    }
+    
+    /* Convert result back to Python */
+    PyObject* py_result = matrix_result(result, W_arg.from_buffer || H_arg.from_buffer);
+    if (!py_result) {
+        Py_RETURN_NONE;
+    }
+    return py_result;
+}
+
+/* Python wrapper for symnmf function */
+static PyObject* py_symnmf(PyObject* self, PyObject* args) {
+    return py_symnmf_common(args, symnmf);
+}
+
+/* Python wrapper for symnmf_mixed function */
+static PyObject* py_symnmf_mixed(PyObject* self, PyObject* args) {
+    return py_symnmf_common(args, symnmf_mixed);
+}
+
+/* Python wrapper for sym_f32 and norm_f32
+ * Converts Python input to C, calls the single-precision builder, converts the result back to Python
+ */
+static PyObject* py_f32_common(PyObject* args, fmatrix_t* (*builder)(const matrix_t*, int)) {
     PyObject *py_points;
+    matrix_arg_t points_arg;
+    int num_threads = 0;
     /* Parse Python arguments */
-    if (!PyArg_ParseTuple(args, "O", &py_points)) return NULL;
-    int n = PyList_Size(py_points);
-    int d = PyList_Size(PyList_GetItem(py_points, 0));
+    if (!PyArg_ParseTuple(args, "O|i", &py_points, &num_threads)) return NULL;
     
-    /* Convert input to C array */
-    double **points = py_list_to_c_array(py_points, n, d);
+    /* Convert input to C matrix */
+    const matrix_t *points = matrix_arg_get(py_points, -1, -1, &points_arg);
     if (!points) {
+        matrix_arg_release(&points_arg);
         Py_RETURN_NONE;
     }
     
-    /* Call C function */
-    double **result = ddg(points, n, d);
+    /* Call C function without holding the GIL */
+    fmatrix_t *result;
+    Py_BEGIN_ALLOW_THREADS
+    result = builder(points, num_threads);
+    Py_END_ALLOW_THREADS
+    matrix_arg_release(&points_arg);
     if (!result) {
-        free_c_array(points, n);
         Py_RETURN_NONE;
     }
     
     /* Convert result back to Python */
-    PyObject* py_result = c_array_to_py_list(result, n, n);
-    free_c_array(points, n);
-    free_c_array(result, n);
+    PyObject* py_result = fmatrix_result(result, points_arg.from_buffer);
     if (!py_result) {
         Py_RETURN_NONE;
     }
     return py_result;
 }
 
-/* Python wrapper for norm function
- * Converts Python input to C, calls norm, converts result back to Python
+/* Python wrapper for sym_f32 function */
+static PyObject* py_sym_f32(PyObject* self, PyObject* args) {
+    return py_f32_common(args, sym_f32);
+}
+
+/* Python wrapper for norm_f32 function */
+static PyObject* py_norm_f32(PyObject* self, PyObject* args) {
+    return py_f32_common(args, norm_f32);
+}
+
+/* Python wrapper for symnmf_f32 function
+ * Takes W in single precision (rounding it if needed), calls symnmf_f32, converts result back to Python
  */
-static PyObject* py_norm(PyObject* self, PyObject* args) {
+static PyObject* py_symnmf_f32(PyObject* self, PyObject* args) {
+    PyObject *py_W, *py_H;
+    matrix_arg_t W_arg, H_arg;
+    int n, k;
+    int num_threads = 0;
+    /* Parse Python arguments */
+    if (!PyArg_ParseTuple(args, "OOii|i", &py_W, &py_H, &n, &k, &num_threads)) return NULL;
+    if (PyObject_TypeCheck(py_W, &AffinityType)) {
+        return py_symnmf_handle((AffinityObject*)py_W, py_H, n, k, num_threads, 0);
+    }
+    
+    /* Convert inputs to C matrices */
+    const fmatrix_t *W = fmatrix_arg_get(py_W, n, n, &W_arg);
+    if (!W) {
+        matrix_arg_release(&W_arg);
+        Py_RETURN_NONE;
+    }
+    
+    const matrix_t *H = matrix_arg_get(py_H, n, k, &H_arg);
+    if (!H) {
+        matrix_arg_release(&W_arg);
+        matrix_arg_release(&H_arg);
+        Py_RETURN_NONE;
+    }
+    
+    /* Call C function without holding the GIL */
+    matrix_t *result;
+    Py_BEGIN_ALLOW_THREADS
+    result = symnmf_f32(W, H, num_threads);
+    Py_END_ALLOW_THREADS
+    matrix_arg_release(&W_arg);
+    matrix_arg_release(&H_arg);
+    if (!result) {
+        Py_RETURN_NONE;
+    }
+    
+    /* Convert result back to Python */
+    PyObject* py_result = matrix_result(result, W_arg.from_buffer || H_arg.from_buffer);
+    if (!py_result) {
+        Py_RETURN_NONE;
+    }
+    return py_result;
+}
+
+/* Python wrapper for knn_sym and knn_norm
+ * Converts Python input to C, calls the kNN builder, converts the sparse result back to Python
+ */
+static PyObject* py_knn_common(PyObject* args,
+                               csr_matrix_t* (*builder)(const matrix_t*, size_t, int)) {
     PyObject *py_points;
+    matrix_arg_t points_arg;
+    Py_ssize_t neighbors = DEFAULT_NEIGHBORS;
+    int num_threads = 0;
     /* Parse Python arguments */
-    if (!PyArg_ParseTuple(args, "O", &py_points)) return NULL;
-    int n = PyList_Size(py_points);
-    int d = PyList_Size(PyList_GetItem(py_points, 0));
+    if (!PyArg_ParseTuple(args, "O|ni", &py_points, &neighbors, &num_threads)) return NULL;
+    if (neighbors <= 0) {
+        Py_RETURN_NONE;
+    }
     
-    /* Convert input to C array */
-    double **points = py_list_to_c_array(py_points, n, d);
+    /* Convert input to C matrix */
+    const matrix_t *points = matrix_arg_get(py_points, -1, -1, &points_arg);
     if (!points) {
+        matrix_arg_release(&points_arg);
         Py_RETURN_NONE;
     }
     
-    /* Call C function */
-    double **result = norm(points, n, d);
+    /* Call C function without holding the GIL */
+    csr_matrix_t *result;
+    Py_BEGIN_ALLOW_THREADS
+    result = builder(points, (size_t)neighbors, num_threads);
+    Py_END_ALLOW_THREADS
+    matrix_arg_release(&points_arg);
     if (!result) {
-        free_c_array(points, n);
         Py_RETURN_NONE;
     }
     
     /* Convert result back to Python */
-    PyObject* py_result = c_array_to_py_list(result, n, n);
-    free_c_array(points, n);
-    free_c_array(result, n);
+    PyObject* py_result = csr_to_py_tuple(result);
+    csr_free(result);
     if (!py_result) {
         Py_RETURN_NONE;
     }
     return py_result;
 }
 
-/* Python wrapper for symnmf function
- * Converts Python input to C, calls symnmf, converts result back to Python
+/* Python wrapper for knn_sym function */
+static PyObject* py_knn_sym(PyObject* self, PyObject* args) {
+    return py_knn_common(args, knn_sym);
+}
+
+/* Python wrapper for knn_norm function */
+static PyObject* py_knn_norm(PyObject* self, PyObject* args) {
+    return py_knn_common(args, knn_norm);
+}
+
+/* Python wrapper for symnmf_sparse function
+ * Converts Python input to C, calls symnmf_sparse, converts result back to Python
  */
-static PyObject* py_symnmf(PyObject* self, PyObject* args) {
+static PyObject* py_symnmf_sparse(PyObject* self, PyObject* args) {
     PyObject *py_W, *py_H;
+    matrix_arg_t H_arg;
     int n, k;
+    int num_threads = 0;
     /* Parse Python arguments */
-    if (!PyArg_ParseTuple(args, "OOii", &py_W, &py_H, &n, &k)) return NULL;
+    if (!PyArg_ParseTuple(args, "OOii|i", &py_W, &py_H, &n, &k, &num_threads)) return NULL;
+    if (PyObject_TypeCheck(py_W, &AffinityType)) {
+        return py_symnmf_handle((AffinityObject*)py_W, py_H, n, k, num_threads, 0);
+    }
     
-    /* Convert inputs to C arrays */
-    double **W = py_list_to_c_array(py_W, n, n);
+    /* Convert inputs to C matrices */
+    csr_matrix_t *W = py_tuple_to_csr(py_W, n);
     if (!W) {
         Py_RETURN_NONE;
     }
     
-    double **H = py_list_to_c_array(py_H, n, k);
+    const matrix_t *H = matrix_arg_get(py_H, n, k, &H_arg);
+    if (!H) {
+        csr_free(W);
+        matrix_arg_release(&H_arg);
+        Py_RETURN_NONE;
+    }
+    
+    /* Call C function without holding the GIL */
+    matrix_t *result;
+    Py_BEGIN_ALLOW_THREADS
+    result = symnmf_sparse(W, H, num_threads);
+    Py_END_ALLOW_THREADS
+    csr_free(W);
+    matrix_arg_release(&H_arg);
+    if (!result) {
+        Py_RETURN_NONE;
+    }
+    
+    /* Convert result back to Python */
+    PyObject* py_result = matrix_result(result, H_arg.from_buffer);
+    if (!py_result) {
+        Py_RETURN_NONE;
+    }
+    return py_result;
+}
+
+/* Python wrapper for symnmf_matrix_free function
+ * Converts Python input to C, calls symnmf_matrix_free, converts result back to Python
+ */
+static PyObject* py_symnmf_matrix_free(PyObject* self, PyObject* args) {
+    PyObject *py_points, *py_H;
+    matrix_arg_t points_arg, H_arg;
+    int n, k;
+    int num_threads = 0;
+    /* Parse Python arguments */
+    if (!PyArg_ParseTuple(args, "OOii|i", &py_points, &py_H, &n, &k, &num_threads)) return NULL;
+    if (n <= 0) {
+        Py_RETURN_NONE;
+    }
+    
+    /* Convert inputs to C matrices */
+    const matrix_t *points = matrix_arg_get(py_points, n, -1, &points_arg);
+    if (!points) {
+        matrix_arg_release(&points_arg);
+        Py_RETURN_NONE;
+    }
+    
+    const matrix_t *H = matrix_arg_get(py_H, n, k, &H_arg);
     if (!H) {
-        free_c_array(W, n);
+        matrix_arg_release(&points_arg);
+        matrix_arg_release(&H_arg);
         Py_RETURN_NONE;
     }
     
-    /* Call C function */
-    double **result = symnmf(W, H, n, k);
+    /* Call C function without holding the GIL */
+    matrix_t *result;
+    Py_BEGIN_ALLOW_THREADS
+    result = symnmf_matrix_free(points, H, num_threads);
+    Py_END_ALLOW_THREADS
+    matrix_arg_release(&points_arg);
+    matrix_arg_release(&H_arg);
     if (!result) {
-        free_c_array(W, n);
-        free_c_array(H, n);
         Py_RETURN_NONE;
     }
     
     /* Convert result back to Python */
-    PyObject* py_result = c_array_to_py_list(result, n, k);
-    free_c_array(W, n);
-    free_c_array(H, n);
-    free_c_array(result, n);
+    PyObject* py_result = matrix_result(result, points_arg.from_buffer || H_arg.from_buffer);
+    if (!py_result) {
+        Py_RETURN_NONE;
+    }
+    return py_result;
+}
+
+/* Python wrapper for norm_mean function
+ * Converts Python input to C, calls norm_mean, returns the mean as a float
+ */
+static PyObject* py_norm_mean(PyObject* self, PyObject* args) {
+    PyObject *py_points;
+    matrix_arg_t points_arg;
+    int num_threads = 0;
+    /* Parse Python arguments */
+    if (!PyArg_ParseTuple(args, "O|i", &py_points, &num_threads)) return NULL;
+    
+    /* Convert input to C matrix */
+    const matrix_t *points = matrix_arg_get(py_points, -1, -1, &points_arg);
+    if (!points) {
+        matrix_arg_release(&points_arg);
+        Py_RETURN_NONE;
+    }
+    
+    /* Call C function without holding the GIL */
+    double mean;
+    Py_BEGIN_ALLOW_THREADS
+    mean = norm_mean(points, num_threads);
+    Py_END_ALLOW_THREADS
+    matrix_arg_release(&points_arg);
+    if (mean < 0.0) {
+        Py_RETURN_NONE;
+    }
+    return PyFloat_FromDouble(mean);
+}
+
+/* Python wrapper for norm_handle, norm_f32_handle and norm_packed_handle
+ * Converts Python input to C, builds W in the storage of kind and returns it as a symnmf.Affinity
+ */
+static PyObject* py_norm_handle_common(PyObject* args, affinity_kind_t kind) {
+    PyObject *py_points;
+    matrix_arg_t points_arg;
+    int num_threads = 0;
+    /* Parse Python arguments */
+    if (!PyArg_ParseTuple(args, "O|i", &py_points, &num_threads)) return NULL;
+    
+    /* Convert input to C matrix */
+    const matrix_t *points = matrix_arg_get(py_points, -1, -1, &points_arg);
+    if (!points) {
+        matrix_arg_release(&points_arg);
+        Py_RETURN_NONE;
+    }
+    
+    /* Call C function without holding the GIL */
+    matrix_t *dense = NULL;
+    fmatrix_t *dense32 = NULL;
+    packed_matrix_t *packed = NULL;
+    Py_BEGIN_ALLOW_THREADS
+    if (kind == AFFINITY_DENSE_F32) {
+        dense32 = norm_f32(points, num_threads);
+    } else if (kind == AFFINITY_PACKED) {
+        packed = norm_packed(points, num_threads);
+    } else {
+        dense = norm(points, num_threads);
+    }
+    Py_END_ALLOW_THREADS
+    matrix_arg_release(&points_arg);
+    if (!dense && !dense32 && !packed) {
+        Py_RETURN_NONE;
+    }
+    
+    /* Hand ownership to the handle */
+    PyObject* py_result = affinity_to_handle(dense, dense32, NULL, packed);
+    if (!py_result) {
+        Py_RETURN_NONE;
+    }
+    return py_result;
+}
+
+/* Python wrapper for norm_handle function */
+static PyObject* py_norm_handle(PyObject* self, PyObject* args) {
+    return py_norm_handle_common(args, AFFINITY_DENSE);
+}
+
+/* Python wrapper for norm_f32_handle function */
+static PyObject* py_norm_f32_handle(PyObject* self, PyObject* args) {
+    return py_norm_handle_common(args, AFFINITY_DENSE_F32);
+}
+
+/* Python wrapper for norm_packed_handle function */
+static PyObject* py_norm_packed_handle(PyObject* self, PyObject* args) {
+    return py_norm_handle_common(args, AFFINITY_PACKED);
+}
+
+/* Python wrapper for knn_norm_handle function
+ * Converts Python input to C, builds the sparse W and returns it as a symnmf.Affinity
+ */
+static PyObject* py_knn_norm_handle(PyObject* self, PyObject* args) {
+    PyObject *py_points;
+    matrix_arg_t points_arg;
+    Py_ssize_t neighbors = DEFAULT_NEIGHBORS;
+    int num_threads = 0;
+    /* Parse Python arguments */
+    if (!PyArg_ParseTuple(args, "O|ni", &py_points, &neighbors, &num_threads)) return NULL;
+    if (neighbors <= 0) {
+        Py_RETURN_NONE;
+    }
+    
+    /* Convert input to C matrix */
+    const matrix_t *points = matrix_arg_get(py_points, -1, -1, &points_arg);
+    if (!points) {
+        matrix_arg_release(&points_arg);
+        Py_RETURN_NONE;
+    }
+    
+    /* Call C function without holding the GIL */
+    csr_matrix_t *result;
+    Py_BEGIN_ALLOW_THREADS
+    result = knn_norm(points, (size_t)neighbors, num_threads);
+    Py_END_ALLOW_THREADS
+    matrix_arg_release(&points_arg);
+    if (!result) {
+        Py_RETURN_NONE;
+    }
+    
+    /* Hand ownership to the handle */
+    PyObject* py_result = affinity_to_handle(NULL, NULL, result, NULL);
     if (!py_result) {
         Py_RETURN_NONE;
     }
     return py_result;
 }
 
+/* Format for load/save: the named one, else the one implied by the file name
+ * Input: file name, format name or NULL, format to fill
+ * Output: 1 on success, 0 if the name is unknown
+ */
+static int format_arg(const char* filename, const char* name, matio_format_t* format) {
+    *format = matio_format_of(filename);
+    return !name || matio_parse_format(name, format);
+}
+
+/* Python wrapper for matio_read
+ * Reads a text, raw binary or .npy file; float32 files stay float32
+ */
+static PyObject* py_load(PyObject* self, PyObject* args) {
+    PyObject *py_filename;
+    const char *format_name = NULL;
+    int num_threads = 0;
+    /* Parse Python arguments */
+    if (!PyArg_ParseTuple(args, "O&|zi", PyUnicode_FSConverter, &py_filename, &format_name, &num_threads)) {
+        return NULL;
+    }
+    const char *filename = PyBytes_AS_STRING(py_filename);
+    matio_format_t format;
+    if (!format_arg(filename, format_name, &format)) {
+        Py_DECREF(py_filename);
+        Py_RETURN_NONE;
+    }
+    
+    /* Call C function without holding the GIL */
+    matrix_t *matrix;
+    fmatrix_t *fmatrix;
+    int ok;
+    Py_BEGIN_ALLOW_THREADS
+    ok = matio_read(filename, format, num_threads, &matrix, &fmatrix, NULL);
+    Py_END_ALLOW_THREADS
+    Py_DECREF(py_filename);
+    if (!ok) {
+        Py_RETURN_NONE;
+    }
+    
+    /* Hand ownership to the array */
+    PyObject* py_result = result_to_array(matrix, matrix ? NULL : fmatrix);
+    if (!py_result) {
+        Py_RETURN_NONE;
+    }
+    return py_result;
+}
+
+/* Python wrapper for matio_write
+ * Writes a matrix (list, float64/float32 buffer or dense or packed
+ * symnmf.Affinity) as raw binary or .npy, keeping its precision
+ */
+static PyObject* py_save(PyObject* self, PyObject* args) {
+    PyObject *py_filename, *py_matrix;
+    const char *format_name = NULL;
+    /* Parse Python arguments */
+    if (!PyArg_ParseTuple(args, "O&O|z", PyUnicode_FSConverter, &py_filename, &py_matrix, &format_name)) {
+        return NULL;
+    }
+    const char *filename = PyBytes_AS_STRING(py_filename);
+    matio_format_t format;
+    if (!format_arg(filename, format_name, &format) || format == MATIO_TEXT) {
+        Py_DECREF(py_filename);
+        Py_RETURN_NONE;
+    }
+    
+    /* Convert input to C matrix */
+    const matrix_t *matrix = NULL;
+    const fmatrix_t *fmatrix = NULL;
+    const packed_matrix_t *packed = NULL;
+    matrix_arg_t matrix_arg;
+    matrix_arg.copy = NULL;
+    matrix_arg.fcopy = NULL;
+    matrix_arg.has_buffer = 0;
+    if (PyObject_TypeCheck(py_matrix, &AffinityType)) {
+        matrix = ((AffinityObject*)py_matrix)->dense;
+        fmatrix = ((AffinityObject*)py_matrix)->dense32;
+        packed = ((AffinityObject*)py_matrix)->packed;
+    } else if (matrix_arg_buffer(py_matrix, -1, -1, &matrix_arg) == 'f') {
+        matrix_arg_release(&matrix_arg);
+        fmatrix = fmatrix_arg_get(py_matrix, -1, -1, &matrix_arg);
+    } else {
+        matrix_arg_release(&matrix_arg);
+        matrix = matrix_arg_get(py_matrix, -1, -1, &matrix_arg);
+    }
+    if (!matrix && !fmatrix && !packed) {
+        matrix_arg_release(&matrix_arg);
+        Py_DECREF(py_filename);
+        Py_RETURN_NONE;
+    }
+    
+    /* Call C function without holding the GIL */
+    int ok;
+    Py_BEGIN_ALLOW_THREADS
+    ok = packed ? matio_write_packed(filename, format, packed) : matio_write(filename, format, matrix, fmatrix);
+    Py_END_ALLOW_THREADS
+    matrix_arg_release(&matrix_arg);
+    Py_DECREF(py_filename);
+    if (!ok) {
+        Py_RETURN_NONE;
+    }
+    Py_RETURN_TRUE;
+}
+
 /* Module method definitions */
 static PyMethodDef SymNMFMethods[] = {
-    {"symnmf", py_symnmf, METH_VARARGS, "Execute the symNMF algorithm."},
-    {"sym", py_sym, METH_VARARGS, "Calculate the similarity matrix."},
-    {"ddg", py_ddg, METH_VARARGS, "Calculate the Diagonal Degree Matrix."},
-    {"norm", py_norm, METH_VARARGS, "Calculate the normalized similarity matrix."},
+    {"symnmf", py_symnmf, METH_VARARGS, "Execute the symNMF algorithm; W may be a symnmf.Affinity. symnmf(W, H, n, k[, num_threads])"},
+    {"sym", py_sym, METH_VARARGS, "Calculate the similarity matrix. sym(points[, num_threads])"},
+    {"ddg", py_ddg, METH_VARARGS, "Calculate the Diagonal Degree Matrix. ddg(points[, num_threads])"},
+    {"norm", py_norm, METH_VARARGS, "Calculate the normalized similarity matrix. norm(points[, num_threads])"},
+    {"knn_sym", py_knn_sym, METH_VARARGS,
+     "Calculate the sparse kNN similarity matrix as (row_ptr, col_idx, values). knn_sym(points[, neighbors[, num_threads]])"},
+    {"knn_norm", py_knn_norm, METH_VARARGS,
+     "Calculate the sparse normalized kNN similarity matrix as (row_ptr, col_idx, values). knn_norm(points[, neighbors[, num_threads]])"},
+    {"symnmf_sparse", py_symnmf_sparse, METH_VARARGS,
+     "Execute the symNMF algorithm on a sparse W or a symnmf.Affinity. symnmf_sparse(W, H, n, k[, num_threads])"},
+    {"symnmf_matrix_free", py_symnmf_matrix_free, METH_VARARGS,
+     "Execute the symNMF algorithm without storing W. symnmf_matrix_free(points, H, n, k[, num_threads])"},
+    {"sym_f32", py_sym_f32, METH_VARARGS,
+     "Calculate the similarity matrix in single precision. sym_f32(points[, num_threads])"},
+    {"norm_f32", py_norm_f32, METH_VARARGS,
+     "Calculate the normalized similarity matrix in single precision. norm_f32(points[, num_threads])"},
+    {"symnmf_f32", py_symnmf_f32, METH_VARARGS,
+     "Execute the symNMF algorithm on a single-precision W or a symnmf.Affinity. symnmf_f32(W, H, n, k[, num_threads])"},
+    {"symnmf_mixed", py_symnmf_mixed, METH_VARARGS,
+     "Execute the symNMF algorithm with single-precision iterations and a double-precision polish; W may be a dense symnmf.Affinity. symnmf_mixed(W, H, n, k[, num_threads])"},
+    {"norm_mean", py_norm_mean, METH_VARARGS,
+     "Calculate the mean of the normalized similarity matrix without storing it. norm_mean(points[, num_threads])"},
+    {"norm_handle", py_norm_handle, METH_VARARGS,
+     "Calculate the normalized similarity matrix and keep it in C as a symnmf.Affinity. norm_handle(points[, num_threads])"},
+    {"norm_f32_handle", py_norm_f32_handle, METH_VARARGS,
+     "Calculate the single-precision normalized similarity matrix as a symnmf.Affinity. norm_f32_handle(points[, num_threads])"},
+    {"norm_packed_handle", py_norm_packed_handle, METH_VARARGS,
+     "Calculate the normalized similarity matrix in packed upper-triangular storage as a symnmf.Affinity. norm_packed_handle(points[, num_threads])"},
+    {"knn_norm_handle", py_knn_norm_handle, METH_VARARGS,
+     "Calculate the sparse normalized kNN similarity matrix as a symnmf.Affinity. knn_norm_handle(points[, neighbors[, num_threads]])"},
+    {"load", py_load, METH_VARARGS,
+     "Read a matrix file; format is 'txt', 'bin' or 'npy', by default from the extension. load(filename[, format[, num_threads]])"},
+    {"save", py_save, METH_VARARGS,
+     "Write a matrix or dense or packed symnmf.Affinity as 'bin' or 'npy', by default from the extension; True on success. save(filename, matrix[, format])"},
     {NULL, NULL, 0, NULL}
 };
 
@@ -217,5 +1253,29 @@ static struct PyModuleDef symnmfmodule = {
 
 /* Module initialization function */
 PyMODINIT_FUNC PyInit_symnmf(void) {
-    return PyModule_Create(&symnmfmodule);
+    if (PyType_Ready(&MatrixType) < 0 || PyType_Ready(&AffinityType) < 0) {
+        return NULL;
+    }
+    PyObject* module = PyModule_Create(&symnmfmodule);
+    if (!module) {
+        return NULL;
+    }
+    Py_INCREF(&MatrixType);
+    if (PyModule_AddObject(module, "Matrix", (PyObject*)&MatrixType) < 0) {
+        Py_DECREF(&MatrixType);
+        Py_DECREF(module);
+        return NULL;
+    }
+    Py_INCREF(&AffinityType);
+    if (PyModule_AddObject(module, "Affinity", (PyObject*)&AffinityType) < 0) {
+        Py_DECREF(&AffinityType);
+        Py_DECREF(module);
+        return NULL;
+    }
+    /* Results are wrapped with numpy.asarray when NumPy is available */
+    numpy_module = PyImport_ImportModule("numpy");
+    if (!numpy_module) {
+        PyErr_Clear();
+    }
+    return module;
 }
\ No newline at end of file
@@ -0,0 +1,84 @@
+#!/bin/sh
+# Regression check of the C program against a baseline commit
+#
+#   tests/regress.sh [BASELINE_REF]
+#
+# Builds this tree and BASELINE_REF (default: the first commit) side by
+# side, then runs sym, ddg and norm on a set of generated inputs for every
+# SYMNMF_ISA and several SYMNMF_NUM_THREADS values. Their text output must
+# be byte-for-byte that of the baseline program. The symnmf goal, which the
+# baseline only offers through its Python module, must give the same bytes
+# for every instruction set and thread count and stay within NMF_TOLERANCE
+# of the baseline module. symnmf_mixed of this tree must stay within
+# MIXED_TOLERANCE (symnmf.c) of its symnmf, and its buffer results must be
+# C-contiguous and equal to its list results. Exits 1 on any difference.
+
+NMF_TOLERANCE=${NMF_TOLERANCE:-1e-3}
+MIXED_TOLERANCE=${MIXED_TOLERANCE:-1e-6}
+ISAS="sse2 avx2 avx512"
+THREADS="1 2 3 8"
+
+cd "$(dirname "$0")/.." || exit 1
+root=$(pwd)
+ref=${1:-$(git rev-list --max-parents=0 HEAD | tail -n 1)}
+work=$(mktemp -d) || exit 1
+cleanup() {
+    git -C "$root" worktree remove --force "$work/baseline" >/dev/null 2>&1
+    rm -rf "$work"
+}
+trap cleanup EXIT
+trap 'exit 1' INT TERM
+
+(make -s && python3 setup.py -q build_ext --inplace) >"$work/make.log" 2>&1 || { cat "$work/make.log"; exit 1; }
+git worktree add -q --detach "$work/baseline" "$ref" || exit 1
+(cd "$work/baseline" && make -s && python3 setup.py -q build_ext --inplace) >"$work/baseline.log" 2>&1 \
+    || { cat "$work/baseline.log"; exit 1; }
+mkdir "$work/in" "$work/out"
+python3 tests/regress_helper.py inputs "$work/in" >"$work/inputs" || exit 1
+
+status=0
+fail() {
+    echo "FAIL $*"
+    status=1
+}
+
+while read -r input k; do
+    name=$(basename "$input" .txt)
+    for goal in sym ddg norm; do
+        "$work/baseline/symnmf" "$goal" "$input" >"$work/out/$name.$goal.base"
+    done
+    python3 tests/regress_helper.py symnmf "$work/baseline" "$input" "$k" >"$work/out/$name.symnmf.base" \
+        || fail "baseline symnmf $name"
+    python3 tests/regress_helper.py mixed "$root" "$input" "$k" "$MIXED_TOLERANCE" || fail "symnmf_mixed $name"
+    python3 tests/regress_helper.py layout "$root" "$input" || fail "buffer results $name"
+    rm -f "$work/out/$name.symnmf.first"
+    for isa in $ISAS; do
+        for threads in $THREADS; do
+            for goal in sym ddg norm; do
+                out="$work/out/$name.$goal.out"
+                SYMNMF_ISA=$isa SYMNMF_NUM_THREADS=$threads ./symnmf "$goal" "$input" >"$out"
+                cmp -s "$out" "$work/out/$name.$goal.base" || fail "$goal $name isa=$isa threads=$threads"
+            done
+            out="$work/out/$name.symnmf.out"
+            SYMNMF_ISA=$isa SYMNMF_NUM_THREADS=$threads ./symnmf symnmf "$input" "$k" >"$out"
+            if [ -f "$work/out/$name.symnmf.first" ]; then
+                cmp -s "$out" "$work/out/$name.symnmf.first" || fail "symnmf $name isa=$isa threads=$threads"
+            else
+                cp "$out" "$work/out/$name.symnmf.first"
+                python3 tests/regress_helper.py close "$out" "$work/out/$name.symnmf.base" "$NMF_TOLERANCE" \
+                    || fail "symnmf $name against the baseline"
+            fi
+        done
+    done
+done <"$work/inputs"
+
+# Malformed options are errors, never positional arguments
+input=$(head -n 1 "$work/inputs" | cut -d ' ' -f 1)
+for args in "sym $input -f npz" "-f npz sym $input" "sym $input -f" "sym $input -o"; do
+    ./symnmf $args >"$work/out/options.out" 2>"$work/out/options.err" && fail "symnmf $args succeeded"
+    [ "$(cat "$work/out/options.out")" = "An Error Has Occurred" ] || fail "symnmf $args printed no error"
+    grep -q -e "unknown format" -e "needs a value" "$work/out/options.err" || fail "symnmf $args did not name the bad option"
+done
+
+[ $status = 0 ] && echo "regress: all outputs match"
+exit $status
@@ -0,0 +1,144 @@
+"""
+Helpers of regress.sh, which needs no NumPy.
+    inputs DIR              write the input files into DIR and list them with their k
+    symnmf MODULE_DIR FILE K
+                            run the symnmf module found in MODULE_DIR the way symnmf.py
+                            does (numpy.random.seed(1234), H ~ U[0, 2*sqrt(mean(W)/k)])
+    mixed MODULE_DIR FILE K TOL
+                            exit 1 unless symnmf_mixed and symnmf of that module
+                            agree within TOL on the same problem
+    layout MODULE_DIR FILE  exit 1 unless buffer results of that module are C-contiguous
+                            and equal to its list results
+    close FILE_A FILE_B TOL exit 1 unless the two matrices agree within TOL
+"""
+import os
+import random
+import struct
+import sys
+
+
+class MT19937:
+    """NumPy's RandomState stream: seeded with one 32-bit word, 53-bit doubles."""
+
+    def __init__(self, seed):
+        self.mt = [seed & 0xffffffff]
+        for i in range(1, 624):
+            prev = self.mt[-1]
+            self.mt.append((1812433253 * (prev ^ (prev >> 30)) + i) & 0xffffffff)
+        self.index = 624
+
+    def _word(self):
+        if self.index >= 624:
+            for i in range(624):
+                y = (self.mt[i] & 0x80000000) | (self.mt[(i + 1) % 624] & 0x7fffffff)
+                self.mt[i] = self.mt[(i + 397) % 624] ^ (y >> 1) ^ (0x9908b0df if y & 1 else 0)
+            self.index = 0
+        y = self.mt[self.index]
+        self.index += 1
+        y ^= y >> 11
+        y ^= (y << 7) & 0x9d2c5680
+        y ^= (y << 15) & 0xefc60000
+        y ^= y >> 18
+        return y & 0xffffffff
+
+    def uniform(self):
+        a = self._word() >> 5
+        b = self._word() >> 6
+        return (a * 67108864.0 + b) / 9007199254740992.0
+
+
+def write_inputs(directory):
+    # (name, points, dimensions, clusters): blank-free files of 4-decimal values;
+    # the wide one takes the dot-product distance path (16 dimensions and up)
+    shapes = [("tiny", 9, 3, 2), ("small", 40, 3, 3), ("odd", 137, 4, 4),
+              ("tile", 65, 5, 3), ("medium", 300, 2, 3), ("wide", 70, 20, 3)]
+    rng = random.Random(2024)
+    for name, n, d, k in shapes:
+        centers = [[rng.uniform(-5, 5) for _ in range(d)] for _ in range(k)]
+        path = os.path.join(directory, name + ".txt")
+        with open(path, "w") as out:
+            for i in range(n):
+                center = centers[i % k]
+                out.write(",".join("%.4f" % (c + rng.gauss(0, 1)) for c in center) + "\n")
+        print(path, k)
+
+
+def load_problem(module_dir, file_name, k):
+    sys.path.insert(0, module_dir)
+    import symnmf
+    data = [[float(x) for x in line.split(",")] for line in open(file_name) if line.strip()]
+    n = len(data)
+    W = symnmf.norm(data)
+    mean = sum(map(sum, W)) / (n * n)
+    rng = MT19937(1234)
+    upper = 2 * (mean / k) ** 0.5
+    H = [[upper * rng.uniform() for _ in range(k)] for _ in range(n)]
+    return symnmf, W, H, n
+
+
+def run_symnmf(module_dir, file_name, k):
+    symnmf, W, H, n = load_problem(module_dir, file_name, k)
+    for row in symnmf.symnmf(W, H, n, k):
+        print(",".join("%.4f" % x for x in row))
+
+
+def mixed(module_dir, file_name, k, tolerance):
+    # symnmf_mixed must land within tolerance of the all-double symnmf
+    symnmf, W, H, n = load_problem(module_dir, file_name, k)
+    a = symnmf.symnmf(W, H, n, k)
+    b = symnmf.symnmf_mixed(W, H, n, k)
+    worst = max(abs(x - y) for r, s in zip(a, b) for x, y in zip(r, s))
+    if worst > tolerance:
+        print("symnmf_mixed off by %.3g, above %g: %s" % (worst, tolerance, file_name))
+        return 1
+    return 0
+
+
+def layout(module_dir, file_name):
+    # Buffer in gives an array (or symnmf.Matrix without NumPy) out, which must be
+    # a C-contiguous view of the same values the list interface returns
+    symnmf, W, H, n = load_problem(module_dir, file_name, 2)
+    data = [[float(x) for x in line.split(",")] for line in open(file_name) if line.strip()]
+    d = len(data[0])
+    flat = struct.pack("%dd" % (n * d), *[x for row in data for x in row])
+    points = memoryview(flat).cast("B").cast("d", (n, d))
+    for name, result, expected in [("norm", symnmf.norm(points), W),
+                                   ("symnmf", symnmf.symnmf(symnmf.norm(points), H, n, 2),
+                                    symnmf.symnmf(W, H, n, 2))]:
+        view = memoryview(result)
+        if not view.c_contiguous or view.shape != (len(expected), len(expected[0])):
+            print("%s result is not a C-contiguous %dx%d buffer: %s" % (name, len(expected), len(expected[0]), file_name))
+            return 1
+        if view.tolist() != expected:
+            print("%s buffer result differs from the list result: %s" % (name, file_name))
+            return 1
+    return 0
+
+
+def close(file_a, file_b, tolerance):
+    a = [[float(x) for x in line.split(",")] for line in open(file_a) if line.strip()]
+    b = [[float(x) for x in line.split(",")] for line in open(file_b) if line.strip()]
+    if len(a) != len(b) or any(len(r) != len(s) for r, s in zip(a, b)):
+        print("shape mismatch: %s %s" % (file_a, file_b))
+        return 1
+    worst = max((abs(x - y) for r, s in zip(a, b) for x, y in zip(r, s)), default=0.0)
+    if worst > tolerance:
+        print("max difference %.3g above %g: %s %s" % (worst, tolerance, file_a, file_b))
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    if len(sys.argv) == 3 and sys.argv[1] == "inputs":
+        write_inputs(sys.argv[2])
+    elif len(sys.argv) == 5 and sys.argv[1] == "symnmf":
+        run_symnmf(sys.argv[2], sys.argv[3], int(sys.argv[4]))
+    elif len(sys.argv) == 6 and sys.argv[1] == "mixed":
+        sys.exit(mixed(sys.argv[2], sys.argv[3], int(sys.argv[4]), float(sys.argv[5])))
+    elif len(sys.argv) == 4 and sys.argv[1] == "layout":
+        sys.exit(layout(sys.argv[2], sys.argv[3]))
+    elif len(sys.argv) == 5 and sys.argv[1] == "close":
+        sys.exit(close(sys.argv[2], sys.argv[3], float(sys.argv[4])))
+    else:
+        print(__doc__)
+        sys.exit(2)
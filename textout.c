@@ -0,0 +1,352 @@
+/*
+ * Buffered text output
+ * A value is printed from the integer round(|x| * 10^4) when the scaled
+ * product is far enough from a rounding tie that its own rounding error
+ * cannot change the result; ties, near-ties, huge values, infinities and
+ * NaN go through sprintf. Either way the bytes are those of "%.4f".
+ */
+
+#if defined(__unix__) || defined(__APPLE__)
+#define _POSIX_C_SOURCE 200112L
+#define TEXTOUT_WRITE
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+#ifdef TEXTOUT_WRITE
+#include <errno.h>
+#include <unistd.h>
+#endif
+#include "textout.h"
+#include "parallel.h"
+
+/* Longest "%.4f" of a double: sign, 309 digits, point, 4 decimals, separator */
+#define TEXTOUT_MAX_VALUE 320
+
+/* Longest "row,col," prefix of a sparse entry */
+#define TEXTOUT_MAX_INDEX 44
+
+/* Target size of the text of one block of rows */
+#define TEXTOUT_BLOCK_BYTES (256 * 1024)
+
+/* Blocks per thread formatted before they are written */
+#define TEXTOUT_BLOCKS_PER_THREAD 4
+
+/* Largest |x| printed without sprintf, keeping |x| * 10^4 an exact integer in an unsigned long */
+#if ULONG_MAX > 0xffffffffUL
+#define TEXTOUT_FAST_LIMIT 1e11
+#else
+#define TEXTOUT_FAST_LIMIT 4e5
+#endif
+
+/* Bound on the relative rounding error of |x| * 10^4, with room to spare (2^-53 is 1.1e-16) */
+#define TEXTOUT_PRODUCT_ERROR 4e-16
+
+/*
+ * Growable text of one block of rows
+ * @field data: The characters
+ * @field length: Characters used
+ * @field capacity: Characters allocated
+ * @field failed: Whether an allocation failed
+ * @field row: Scratch row a packed matrix is gathered into, allocated on first use
+ */
+typedef struct textout_buffer_t {
+    char* data;
+    size_t length;
+    size_t capacity;
+    int failed;
+    double* row;
+} textout_buffer_t;
+
+/* Text of an off-diagonal entry of a diagonal matrix */
+#define TEXTOUT_ZERO "0.0000"
+#define TEXTOUT_ZERO_LENGTH 6
+
+/*
+ * What is being written: exactly one of the matrices is set
+ * @field matrix: Double-precision matrix
+ * @field fmatrix: Single-precision matrix
+ * @field csr: Sparse matrix
+ * @field diag: Diagonal matrix, written with all its zeros
+ * @field packed: Packed symmetric matrix, written with both triangles
+ * @field rows: Number of rows of the one that is set
+ */
+typedef struct textout_source_t {
+    const matrix_t* matrix;
+    const fmatrix_t* fmatrix;
+    const csr_matrix_t* csr;
+    const diag_matrix_t* diag;
+    const packed_matrix_t* packed;
+    size_t rows;
+} textout_source_t;
+
+/* Make room for extra more characters; returns 0 if memory runs out */
+static int reserve(textout_buffer_t* buffer, size_t extra) {
+    size_t capacity;
+    char* data;
+
+    if (buffer->length + extra <= buffer->capacity) return 1;
+    capacity = buffer->capacity * 2;
+    if (capacity < buffer->length + extra) capacity = buffer->length + extra;
+    data = (char*)realloc(buffer->data, capacity);
+    if (!data) {
+        buffer->failed = 1;
+        return 0;
+    }
+    buffer->data = data;
+    buffer->capacity = capacity;
+    return 1;
+}
+
+/* Write value as "%.4f" at p; returns the end of the text */
+static char* format_value(char* p, double value) {
+    char digits[24];
+    double magnitude, scaled, whole, fraction;
+    unsigned long q;
+    int negative, count;
+
+    if (!(value > -TEXTOUT_FAST_LIMIT && value < TEXTOUT_FAST_LIMIT)) {
+        return p + sprintf(p, "%.4f", value);
+    }
+    negative = value < 0.0 || (value == 0.0 && 1.0 / value < 0.0);
+    magnitude = negative ? -value : value;
+    scaled = magnitude * 1e4;
+    whole = floor(scaled);
+    fraction = scaled - whole;
+    if (fabs(fraction - 0.5) <= scaled * TEXTOUT_PRODUCT_ERROR) {
+        /* Too close to a tie to trust the rounded product */
+        return p + sprintf(p, "%.4f", value);
+    }
+    q = (unsigned long)whole + (fraction > 0.5);
+    if (negative) *p++ = '-';
+    /* Four decimals, the point, then at least one integer digit, built backwards */
+    count = 0;
+    for (; count < 4; count++, q /= 10) digits[count] = (char)('0' + q % 10);
+    digits[count++] = '.';
+    do {
+        digits[count++] = (char)('0' + q % 10);
+        q /= 10;
+    } while (q);
+    while (count) *p++ = digits[--count];
+    return p;
+}
+
+/* Write an index in decimal at p; returns the end of the text */
+static char* format_index(char* p, size_t index) {
+    char digits[24];
+    int count;
+
+    count = 0;
+    do {
+        digits[count++] = (char)('0' + index % 10);
+        index /= 10;
+    } while (index);
+    while (count) *p++ = digits[--count];
+    return p;
+}
+
+/* Append rows [first, last) of the source to the buffer */
+static void format_rows(const textout_source_t* source, size_t first, size_t last,
+                        textout_buffer_t* buffer) {
+    const double* row;
+    const float* frow;
+    size_t i, j, e, cols;
+    char* p;
+
+    for (i = first; i < last; i++) {
+        if (source->csr) {
+            for (e = source->csr->row_ptr[i]; e < source->csr->row_ptr[i + 1]; e++) {
+                if (!reserve(buffer, TEXTOUT_MAX_INDEX + TEXTOUT_MAX_VALUE)) return;
+                p = buffer->data + buffer->length;
+                p = format_index(p, i);
+                *p++ = ',';
+                p = format_index(p, source->csr->col_idx[e]);
+                *p++ = ',';
+                p = format_value(p, source->csr->values[e]);
+                *p++ = '\n';
+                buffer->length = (size_t)(p - buffer->data);
+            }
+            continue;
+        }
+        if (source->diag) {
+            /* Zeros are copied as text, never stored */
+            cols = source->diag->n;
+            if (!reserve(buffer, cols * (TEXTOUT_ZERO_LENGTH + 1) + TEXTOUT_MAX_VALUE)) return;
+            p = buffer->data + buffer->length;
+            for (j = 0; j < cols; j++) {
+                if (j == i) {
+                    p = format_value(p, source->diag->values[i]);
+                } else {
+                    memcpy(p, TEXTOUT_ZERO, TEXTOUT_ZERO_LENGTH);
+                    p += TEXTOUT_ZERO_LENGTH;
+                }
+                *p++ = j + 1 < cols ? ',' : '\n';
+            }
+            buffer->length = (size_t)(p - buffer->data);
+            continue;
+        }
+        if (source->packed) {
+            cols = source->packed->n;
+            if (!buffer->row) buffer->row = (double*)malloc(cols * sizeof(double));
+            if (!buffer->row) {
+                buffer->failed = 1;
+                return;
+            }
+            packed_get_row(source->packed, i, buffer->row);
+            row = buffer->row;
+            frow = NULL;
+        } else {
+            cols = source->matrix ? source->matrix->cols : source->fmatrix->cols;
+            row = source->matrix ? MATRIX_ROW(source->matrix, i) : NULL;
+            frow = source->fmatrix ? FMATRIX_ROW(source->fmatrix, i) : NULL;
+        }
+        for (j = 0; j < cols; j++) {
+            if (!reserve(buffer, TEXTOUT_MAX_VALUE)) return;
+            p = buffer->data + buffer->length;
+            p = format_value(p, row ? row[j] : (double)frow[j]);
+            *p++ = j + 1 < cols ? ',' : '\n';
+            buffer->length = (size_t)(p - buffer->data);
+        }
+    }
+}
+
+/* Write all of data to the stream's file; returns 0 on error */
+static int emit(FILE* stream, const char* data, size_t length) {
+#ifdef TEXTOUT_WRITE
+    ssize_t written;
+    int fd;
+
+    fd = fileno(stream);
+    while (length > 0) {
+        written = write(fd, data, length);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return 0;
+        }
+        data += written;
+        length -= (size_t)written;
+    }
+    return 1;
+#else
+    return fwrite(data, 1, length, stream) == length;
+#endif
+}
+
+/* Estimated characters per row, to size the blocks */
+static size_t row_bytes(const textout_source_t* source) {
+    size_t entries;
+
+    if (source->csr) {
+        entries = source->rows ? source->csr->row_ptr[source->rows] / source->rows : 0;
+        return entries * 24 + 1;
+    }
+    if (source->diag) return source->diag->n * (TEXTOUT_ZERO_LENGTH + 1);
+    if (source->packed) return source->packed->n * 8;
+    entries = source->matrix ? source->matrix->cols : source->fmatrix->cols;
+    return entries * 8;
+}
+
+/* Format blocks of rows in parallel and write them in row order */
+static int write_source(FILE* stream, const textout_source_t* source, int num_threads) {
+    textout_buffer_t* buffers;
+    size_t block_rows, num_blocks, first, b, begin, end;
+    int ok;
+
+    if (fflush(stream) != 0) return 0;
+    num_threads = resolve_num_threads(num_threads);
+    block_rows = TEXTOUT_BLOCK_BYTES / row_bytes(source);
+    if (block_rows == 0) block_rows = 1;
+    num_blocks = (size_t)num_threads * TEXTOUT_BLOCKS_PER_THREAD;
+    buffers = (textout_buffer_t*)calloc(num_blocks, sizeof(textout_buffer_t));
+    if (!buffers) return 0;
+    ok = 1;
+    for (first = 0; ok && first < source->rows; first += block_rows * num_blocks) {
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 1) num_threads(num_threads) private(begin, end)
+#endif
+        for (b = 0; b < num_blocks; b++) {
+            buffers[b].length = 0;
+            begin = first + b * block_rows;
+            end = begin + block_rows;
+            if (begin > source->rows) begin = source->rows;
+            if (end > source->rows) end = source->rows;
+            format_rows(source, begin, end, &buffers[b]);
+        }
+        for (b = 0; ok && b < num_blocks; b++) {
+            ok = !buffers[b].failed && emit(stream, buffers[b].data, buffers[b].length);
+        }
+    }
+    for (b = 0; b < num_blocks; b++) {
+        free(buffers[b].data);
+        free(buffers[b].row);
+    }
+    free(buffers);
+    return ok;
+}
+
+/* Write a matrix as text */
+int textout_matrix(FILE* stream, const matrix_t* matrix, int num_threads) {
+    textout_source_t source;
+
+    source.matrix = matrix;
+    source.fmatrix = NULL;
+    source.csr = NULL;
+    source.diag = NULL;
+    source.packed = NULL;
+    source.rows = matrix->rows;
+    return write_source(stream, &source, num_threads);
+}
+
+/* Write a single-precision matrix as text */
+int textout_fmatrix(FILE* stream, const fmatrix_t* matrix, int num_threads) {
+    textout_source_t source;
+
+    source.matrix = NULL;
+    source.fmatrix = matrix;
+    source.csr = NULL;
+    source.diag = NULL;
+    source.packed = NULL;
+    source.rows = matrix->rows;
+    return write_source(stream, &source, num_threads);
+}
+
+/* Write a sparse matrix as "row,col,value" lines */
+int textout_sparse(FILE* stream, const csr_matrix_t* matrix, int num_threads) {
+    textout_source_t source;
+
+    source.matrix = NULL;
+    source.fmatrix = NULL;
+    source.csr = matrix;
+    source.diag = NULL;
+    source.packed = NULL;
+    source.rows = matrix->rows;
+    return write_source(stream, &source, num_threads);
+}
+
+/* Write a diagonal matrix as dense text */
+int textout_diagonal(FILE* stream, const diag_matrix_t* matrix, int num_threads) {
+    textout_source_t source;
+
+    source.matrix = NULL;
+    source.fmatrix = NULL;
+    source.csr = NULL;
+    source.diag = matrix;
+    source.packed = NULL;
+    source.rows = matrix->n;
+    return write_source(stream, &source, num_threads);
+}
+
+/* Write a packed symmetric matrix as dense text */
+int textout_packed(FILE* stream, const packed_matrix_t* matrix, int num_threads) {
+    textout_source_t source;
+
+    source.matrix = NULL;
+    source.fmatrix = NULL;
+    source.csr = NULL;
+    source.diag = NULL;
+    source.packed = matrix;
+    source.rows = matrix->n;
+    return write_source(stream, &source, num_threads);
+}
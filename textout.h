@@ -0,0 +1,58 @@
+#ifndef TEXTOUT_H
+#define TEXTOUT_H
+
+#include <stdio.h>
+#include "matrix.h"
+#include "sparse.h"
+
+/* Buffered text output of matrices, byte for byte equal to printf("%.4f") */
+
+/*
+ * Write a matrix as comma-separated rows with 4 decimals
+ * Row blocks are formatted in parallel into large buffers that are
+ * written in order with write(2) (fwrite where that is unavailable);
+ * stream is flushed first, so earlier stdio output stays in place.
+ * @param stream: Destination, e.g. stdout
+ * @param matrix: Matrix to write
+ * @param num_threads: Threads to use, or 0 for SYMNMF_NUM_THREADS / OpenMP default
+ * @return: 1 on success, 0 if memory runs out or writing fails
+ */
+int textout_matrix(FILE* stream, const matrix_t* matrix, int num_threads);
+
+/*
+ * Write a single-precision matrix in the format of textout_matrix
+ * @param stream: Destination, e.g. stdout
+ * @param matrix: Matrix to write
+ * @param num_threads: Threads to use, or 0 for SYMNMF_NUM_THREADS / OpenMP default
+ * @return: 1 on success, 0 if memory runs out or writing fails
+ */
+int textout_fmatrix(FILE* stream, const fmatrix_t* matrix, int num_threads);
+
+/*
+ * Write a sparse matrix as one "row,col,value" line per stored entry
+ * @param stream: Destination, e.g. stdout
+ * @param matrix: Matrix to write
+ * @param num_threads: Threads to use, or 0 for SYMNMF_NUM_THREADS / OpenMP default
+ * @return: 1 on success, 0 if memory runs out or writing fails
+ */
+int textout_sparse(FILE* stream, const csr_matrix_t* matrix, int num_threads);
+
+/*
+ * Write a diagonal matrix in the format of textout_matrix, zeros included
+ * @param stream: Destination, e.g. stdout
+ * @param matrix: Matrix to write
+ * @param num_threads: Threads to use, or 0 for SYMNMF_NUM_THREADS / OpenMP default
+ * @return: 1 on success, 0 if memory runs out or writing fails
+ */
+int textout_diagonal(FILE* stream, const diag_matrix_t* matrix, int num_threads);
+
+/*
+ * Write a packed symmetric matrix in the format of textout_matrix, both triangles
+ * @param stream: Destination, e.g. stdout
+ * @param matrix: Matrix to write
+ * @param num_threads: Threads to use, or 0 for SYMNMF_NUM_THREADS / OpenMP default
+ * @return: 1 on success, 0 if memory runs out or writing fails
+ */
+int textout_packed(FILE* stream, const packed_matrix_t* matrix, int num_threads);
+
+#endif /* TEXTOUT_H */
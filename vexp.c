@@ -0,0 +1,208 @@
+/*
+ * Vectorized exponential
+ * exp(x) = 2^k * exp(r) with k = round(x / ln 2) and |r| <= ln(2) / 2;
+ * r is formed with a two-part (Cody-Waite) ln 2 so the reduction is exact
+ * to about 2^-80, exp(r) is a degree-13 Taylor polynomial (truncation
+ * error below 2^-60), and 2^k is applied as two powers of two so that
+ * subnormal results are rounded once. The AVX2 and AVX-512 variants
+ * evaluate the polynomial with FMA, the SSE2 variant with separate
+ * multiplies and adds.
+ */
+
+#include <math.h>
+#include <string.h>
+#include "vexp.h"
+#include "cpu.h"
+
+#ifdef CPU_X86_64
+#include <immintrin.h>
+
+#define EXP_MIN (-746.0)
+#define EXP_MAX 709.78
+#define LOG2E 1.44269504088896338700e+00
+#define LN2_HI 6.93147180369123816490e-01
+#define LN2_LO 1.90821492927058770002e-10
+
+/* 1.5 * 2^52: adding it rounds to an integer held in the low mantissa bits */
+#define ROUND_MAGIC 6755399441055744.0
+
+/* Taylor coefficients 1/13! .. 1/2!, 1, 1 in Horner order */
+static const double taylor[14] = {
+    1.0 / 6227020800.0, 1.0 / 479001600.0, 1.0 / 39916800.0, 1.0 / 3628800.0,
+    1.0 / 362880.0, 1.0 / 40320.0, 1.0 / 5040.0, 1.0 / 720.0,
+    1.0 / 120.0, 1.0 / 24.0, 1.0 / 6.0, 1.0 / 2.0, 1.0, 1.0
+};
+
+/* 2^k for integral k in [-538, 512]: the exponent field is k + 1023 */
+static __m128d pow2_sse2(__m128d k) {
+    __m128i bits;
+
+    bits = _mm_castpd_si128(_mm_add_pd(k, _mm_set1_pd(ROUND_MAGIC)));
+    bits = _mm_slli_epi64(_mm_add_epi64(bits, _mm_set1_epi64x(1023)), 52);
+    return _mm_castsi128_pd(bits);
+}
+
+/*
+ * exp of two lanes without FMA or a rounding instruction
+ * Rounding goes through ROUND_MAGIC; k * LN2_HI is exact because LN2_HI
+ * has only 32 significant bits, so the reduction loses nothing either.
+ */
+static __m128d exp_sse2(__m128d x) {
+    const __m128d magic = _mm_set1_pd(ROUND_MAGIC);
+    __m128d k, k1, r, p;
+    int c;
+
+    x = _mm_min_pd(_mm_max_pd(x, _mm_set1_pd(EXP_MIN)), _mm_set1_pd(EXP_MAX));
+    k = _mm_sub_pd(_mm_add_pd(_mm_mul_pd(x, _mm_set1_pd(LOG2E)), magic), magic);
+    r = _mm_sub_pd(x, _mm_mul_pd(k, _mm_set1_pd(LN2_HI)));
+    r = _mm_sub_pd(r, _mm_mul_pd(k, _mm_set1_pd(LN2_LO)));
+    p = _mm_set1_pd(taylor[0]);
+    for (c = 1; c < 14; c++) {
+        p = _mm_add_pd(_mm_mul_pd(p, r), _mm_set1_pd(taylor[c]));
+    }
+    /* floor(k / 2) = round(k / 2 - 1/4) for integral k */
+    k1 = _mm_sub_pd(_mm_mul_pd(k, _mm_set1_pd(0.5)), _mm_set1_pd(0.25));
+    k1 = _mm_sub_pd(_mm_add_pd(k1, magic), magic);
+    p = _mm_mul_pd(p, pow2_sse2(k1));
+    return _mm_mul_pd(p, pow2_sse2(_mm_sub_pd(k, k1)));
+}
+
+static void vexp_sse2(const double* x, double* out, size_t count) {
+    double lanes[2];
+    size_t i;
+
+    for (i = 0; i + 2 <= count; i += 2) {
+        _mm_storeu_pd(out + i, exp_sse2(_mm_loadu_pd(x + i)));
+    }
+    if (i < count) {
+        lanes[0] = x[i];
+        lanes[1] = 0.0;
+        _mm_storeu_pd(lanes, exp_sse2(_mm_loadu_pd(lanes)));
+        out[i] = lanes[0];
+    }
+}
+
+/* 2^k for integral k in [-538, 512]: the exponent field is k + 1023 */
+__attribute__((target("avx2,fma")))
+static __m256d pow2_avx2(__m256d k) {
+    __m256i bits;
+
+    bits = _mm256_castpd_si256(_mm256_add_pd(k, _mm256_set1_pd(ROUND_MAGIC)));
+    bits = _mm256_slli_epi64(_mm256_add_epi64(bits, _mm256_set1_epi64x(1023)), 52);
+    return _mm256_castsi256_pd(bits);
+}
+
+/* exp of four lanes */
+__attribute__((target("avx2,fma")))
+static __m256d exp_avx2(__m256d x) {
+    __m256d k, k1, r, p;
+    int c;
+
+    x = _mm256_min_pd(_mm256_max_pd(x, _mm256_set1_pd(EXP_MIN)), _mm256_set1_pd(EXP_MAX));
+    k = _mm256_round_pd(_mm256_mul_pd(x, _mm256_set1_pd(LOG2E)),
+                        _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    r = _mm256_fnmadd_pd(k, _mm256_set1_pd(LN2_HI), x);
+    r = _mm256_fnmadd_pd(k, _mm256_set1_pd(LN2_LO), r);
+    p = _mm256_set1_pd(taylor[0]);
+    for (c = 1; c < 14; c++) {
+        p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(taylor[c]));
+    }
+    k1 = _mm256_floor_pd(_mm256_mul_pd(k, _mm256_set1_pd(0.5)));
+    p = _mm256_mul_pd(p, pow2_avx2(k1));
+    return _mm256_mul_pd(p, pow2_avx2(_mm256_sub_pd(k, k1)));
+}
+
+__attribute__((target("avx2,fma")))
+static void vexp_avx2(const double* x, double* out, size_t count) {
+    double lanes[4];
+    size_t i;
+
+    for (i = 0; i + 4 <= count; i += 4) {
+        _mm256_storeu_pd(out + i, exp_avx2(_mm256_loadu_pd(x + i)));
+    }
+    if (i < count) {
+        memset(lanes, 0, sizeof(lanes));
+        memcpy(lanes, x + i, (count - i) * sizeof(double));
+        _mm256_storeu_pd(lanes, exp_avx2(_mm256_loadu_pd(lanes)));
+        memcpy(out + i, lanes, (count - i) * sizeof(double));
+    }
+}
+
+/* 2^k for integral k in [-538, 512] */
+__attribute__((target("avx512f")))
+static __m512d pow2_avx512(__m512d k) {
+    __m512i bits;
+
+    bits = _mm512_castpd_si512(_mm512_add_pd(k, _mm512_set1_pd(ROUND_MAGIC)));
+    bits = _mm512_slli_epi64(_mm512_add_epi64(bits, _mm512_set1_epi64(1023)), 52);
+    return _mm512_castsi512_pd(bits);
+}
+
+/* exp of eight lanes, the same operation sequence as exp_avx2 */
+__attribute__((target("avx512f")))
+static __m512d exp_avx512(__m512d x) {
+    __m512d k, k1, r, p;
+    int c;
+
+    x = _mm512_min_pd(_mm512_max_pd(x, _mm512_set1_pd(EXP_MIN)), _mm512_set1_pd(EXP_MAX));
+    k = _mm512_roundscale_pd(_mm512_mul_pd(x, _mm512_set1_pd(LOG2E)),
+                             _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    r = _mm512_fnmadd_pd(k, _mm512_set1_pd(LN2_HI), x);
+    r = _mm512_fnmadd_pd(k, _mm512_set1_pd(LN2_LO), r);
+    p = _mm512_set1_pd(taylor[0]);
+    for (c = 1; c < 14; c++) {
+        p = _mm512_fmadd_pd(p, r, _mm512_set1_pd(taylor[c]));
+    }
+    k1 = _mm512_roundscale_pd(_mm512_mul_pd(k, _mm512_set1_pd(0.5)),
+                              _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+    p = _mm512_mul_pd(p, pow2_avx512(k1));
+    return _mm512_mul_pd(p, pow2_avx512(_mm512_sub_pd(k, k1)));
+}
+
+__attribute__((target("avx512f")))
+static void vexp_avx512(const double* x, double* out, size_t count) {
+    double lanes[8];
+    size_t i;
+
+    for (i = 0; i + 8 <= count; i += 8) {
+        _mm512_storeu_pd(out + i, exp_avx512(_mm512_loadu_pd(x + i)));
+    }
+    if (i < count) {
+        memset(lanes, 0, sizeof(lanes));
+        memcpy(lanes, x + i, (count - i) * sizeof(double));
+        _mm512_storeu_pd(lanes, exp_avx512(_mm512_loadu_pd(lanes)));
+        memcpy(out + i, lanes, (count - i) * sizeof(double));
+    }
+}
+
+#else
+
+/* Portable fallback */
+static void vexp_scalar(const double* x, double* out, size_t count) {
+    size_t i;
+
+    for (i = 0; i < count; i++) {
+        out[i] = exp(x[i]);
+    }
+}
+
+#endif
+
+/* Compute out[i] = exp(x[i]) with the kernel of the selected instruction set */
+void vexp(const double* x, double* out, size_t count) {
+#ifdef CPU_X86_64
+    switch (cpu_isa()) {
+    case CPU_ISA_AVX512:
+        vexp_avx512(x, out, count);
+        break;
+    case CPU_ISA_AVX2:
+        vexp_avx2(x, out, count);
+        break;
+    default:
+        vexp_sse2(x, out, count);
+        break;
+    }
+#else
+    vexp_scalar(x, out, count);
+#endif /* CPU_X86_64 */
+}
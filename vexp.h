@@ -0,0 +1,25 @@
+#ifndef VEXP_H
+#define VEXP_H
+
+#include <stddef.h>
+
+/* Vectorized exponential */
+
+/*
+ * Compute out[i] = exp(x[i]) for i < count (out may equal x)
+ * On x86-64 a SIMD kernel for the instruction set chosen by cpu_isa()
+ * is used (SSE2, AVX2+FMA or AVX-512F). Its error against libm stays
+ * within 1 ulp (relative error 2.3e-16) for x in [-708, 709]; subnormal
+ * results for x in [-745, -708] are off by at most one unit of the
+ * smallest subnormal (4.9e-324). Inputs are clamped to [-746, 709.78], so
+ * results saturate at 0 and a finite maximum; NaN inputs are not
+ * supported. Elsewhere libm exp() is used. The AVX2 and AVX-512 kernels
+ * give identical results, and no kernel depends on the position of an
+ * element within the array.
+ * @param x: Input values
+ * @param out: Receives the exponentials
+ * @param count: Number of values
+ */
+void vexp(const double* x, double* out, size_t count);
+
+#endif /* VEXP_H */
\ No newline at end of file